@@ -0,0 +1,443 @@
+// nanocom benchmark workload, used by 'make pgo' and useful on its own.
+//
+// Runs nanocom on a pty console with another pty as its "serial" target, sends several representative streams
+// through it and reports nanocom's CPU time per MB of target output for each. With -f, reports the binary size, RSS
+// when idle and time from exec to "Connected" instead, as used by 'make tiny'. With -l, reports keystroke to target
+// and target to console latency percentiles instead. With -t, checks the rendered console output of each display
+// mode, some over TCP loopback instead of a pty, and the latency percentiles against their limits instead, and exits
+// non-zero if any fail, as used by 'make test'.
+//
+// Usage: bench [-f|-l|-t] [-m MB] [path/to/nanocom]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define die(...) fprintf(stderr, __VA_ARGS__), exit(1)
+
+int megs = 4;                               // MB per stream
+
+// Fill buffer with stream data, return bytes used
+typedef int (*generator)(unsigned char *buf, int size, int line);
+
+// Plain log lines
+int plain(unsigned char *buf, int size, int line)
+{
+    return snprintf((char *)buf, size, "[%8d] kernel: eth0: link up, 1000 Mbps, full duplex, lpa 0x%04X\r\n", line, line & 0xffff);
+}
+
+// Log lines with telnet escaped 0xFF and interleaved NOPs
+int telnet(unsigned char *buf, int size, int line)
+{
+    int n = plain(buf, size, line);
+    buf[n++] = 0xff, buf[n++] = 0xff;       // escaped 0xFF data
+    buf[n++] = 0xff, buf[n++] = 0xf1;       // IAC NOP
+    return n;
+}
+
+// Binary data with some text, for hex display
+int binary(unsigned char *buf, int size, int line)
+{
+    int n = snprintf((char *)buf, size, "frame %d:", line);
+    for (int i = 0; i < 48; i++) buf[n++] = (line * 31 + i * 7) & 0xff;
+    buf[n++] = '\r', buf[n++] = '\n';
+    return n;
+}
+
+// Text with high-bit characters, for transliteration
+int highbit(unsigned char *buf, int size, int line)
+{
+    int n = snprintf((char *)buf, size, "\xc9\xcd\xcd\xcd\xbb %d caf\x82 na\x8bve \xb0\xb1\xb2\xdb \xc8\xcd\xcd\xbc\r\n", line);
+    return n;
+}
+
+// Random bytes with random escape sequences, like a serial port at the wrong baud rate
+int noise(unsigned char *buf, int size, int line)
+{
+    static unsigned int x = 1;
+    int n = 0;
+    while (n < 64)
+    {
+        x ^= x << 13, x ^= x >> 17, x ^= x << 5;  // xorshift
+        if (x % 16) buf[n++] = x >> 8;
+        else n += snprintf((char *)buf + n, size - n, "\e[%u;%u%c", x >> 24, (x >> 16) & 255, "mHJKABCDr?"[(x >> 8) % 10]);
+    }
+    return n;
+}
+
+struct
+{
+    char *name;                             // stream name
+    char *options;                          // nanocom options, space separated
+    generator gen;                          // stream data
+} streams[] = {
+    { "plain",      "",             plain },
+    { "timestamp",  "-s",           plain },
+    { "telnet",     "-t",           telnet },
+    { "hex",        "-h",           binary },
+    { "hexdump",    "-D",           binary },
+    { "utf8",       "-u",           highbit },
+    { "translit",   "-i",           highbit },
+    { "noise",      "-u -w -z",     noise },
+};
+
+// Current time in seconds
+double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Read and discard whatever is available, return true if marker was seen
+bool drain(int fd, char *marker)
+{
+    static char buf[65536];
+    int n = read(fd, buf, sizeof buf);
+    return n > 0 && marker && memmem(buf, n, marker, strlen(marker));
+}
+
+// Start nanocom with options on pty console *cm, return its pid once connected. The target is pty *tm (slave *ts), or
+// if tcp is true the TCP connection *tm accepted on 127.0.0.1 (listener *ts).
+pid_t launch(char *nanocom, char *opts, bool tcp, int *cm, int *tm, int *ts)
+{
+    char target[64];
+    if (tcp)
+    {
+        // listen on any free loopback port, accept once nanocom is running
+        struct sockaddr_in sa = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+        socklen_t len = sizeof sa;
+        *ts = socket(AF_INET, SOCK_STREAM, 0);
+        if (*ts < 0 || bind(*ts, (struct sockaddr *)&sa, len) || listen(*ts, 1) ||
+            getsockname(*ts, (struct sockaddr *)&sa, &len))
+            die("TCP listen failed: %s\n", strerror(errno));
+        sprintf(target, "127.0.0.1:%d", ntohs(sa.sin_port));
+        *tm = -1;
+    }
+    else
+    {
+        // target pty
+        if (openpty(tm, ts, NULL, NULL, NULL)) die("openpty failed: %s\n", strerror(errno));
+        struct termios io;
+        tcgetattr(*ts, &io);
+        cfmakeraw(&io);
+        tcsetattr(*ts, TCSANOW, &io);
+        snprintf(target, sizeof target, "%s", ptsname(*tm));
+    }
+
+    // console pty
+    char *argv[16], options[64];
+    int argc = 0;
+    argv[argc++] = nanocom;
+    strcpy(options, opts);
+    for (char *o = strtok(options, " "); o; o = strtok(NULL, " ")) argv[argc++] = o;
+    argv[argc++] = target;
+    argv[argc] = NULL;
+
+    struct winsize ws = { .ws_row = 24, .ws_col = 80 };
+    pid_t pid = forkpty(cm, NULL, NULL, &ws);
+    if (pid < 0) die("forkpty failed: %s\n", strerror(errno));
+    if (!pid)
+    {
+        if (*tm >= 0) close(*tm);
+        close(*ts);
+        execv(nanocom, argv);
+        die("Can't run %s: %s\n", nanocom, strerror(errno));
+    }
+    if (tcp)
+    {
+        struct pollfd p = { .fd = *ts, .events = POLLIN };
+        if (poll(&p, 1, 5000) <= 0 || (*tm = accept(*ts, NULL, NULL)) < 0) die("%s didn't connect\n", nanocom);
+    }
+    fcntl(*cm, F_SETFL, O_NONBLOCK);
+    fcntl(*tm, F_SETFL, O_NONBLOCK);
+
+    // wait for connect
+    while (1)
+    {
+        struct pollfd p = { .fd = *cm, .events = POLLIN };
+        if (poll(&p, 1, 5000) <= 0) die("%s didn't connect\n", nanocom);
+        if (drain(*cm, "Connected")) return pid;
+    }
+}
+
+// Tell nanocom to quit, return its resource usage
+struct rusage quit(char *nanocom, pid_t pid, int cm, int tm, int ts)
+{
+    struct rusage ru;
+    for (int i = 0; !wait4(pid, NULL, WNOHANG, &ru); i++)
+    {
+        // the console might not be raw yet, so repeat until it works
+        if (i == 50) die("%s won't quit\n", nanocom);
+        if (!(i % 10)) write(cm, "\x1cq", 2);
+        usleep(10000);
+        drain(cm, NULL);
+    }
+    close(cm);
+    close(tm);
+    close(ts);
+    return ru;
+}
+
+// Run nanocom with one stream, return CPU seconds and set *wall to elapsed seconds and *mb to MB sent
+double run(char *nanocom, int s, double *wall, double *mb)
+{
+    int cm, tm, ts;
+    pid_t pid = launch(nanocom, streams[s].options, false, &cm, &tm, &ts);
+
+    // generate stream, about 64K at a time
+    static unsigned char chunk[65536 + 256];
+    long total = (long)megs << 20, sent = 0;
+    int line = 0, len = 0, off = 0;
+    double start = now(), last = start;
+    while (1)
+    {
+        if (off == len && sent < total)
+            for (len = off = 0; len < 65536; line++) len += streams[s].gen(chunk + len, 256, line);
+        struct pollfd p[2] = { { .fd = cm, .events = POLLIN },
+                               { .fd = tm, .events = (off < len) ? POLLIN|POLLOUT : POLLIN } };
+        int r = poll(p, 2, (off < len) ? 5000 : 250);
+        if (!r && off == len) break;        // all sent and console is quiet
+        if (r <= 0) die("%s stalled on %s\n", nanocom, streams[s].name);
+        if (p[0].revents & POLLHUP) die("%s exited on %s\n", nanocom, streams[s].name);
+        if (p[0].revents) drain(cm, NULL), last = now();
+        if (p[1].revents & POLLIN) drain(tm, NULL); // keys and telnet negotiation
+        if (p[1].revents & POLLOUT)
+        {
+            int n = write(tm, chunk + off, len - off);
+            if (n > 0) off += n, sent += n;
+        }
+    }
+    *wall = last - start;
+    *mb = sent / 1048576.0;
+
+    struct rusage ru = quit(nanocom, pid, cm, tm, ts);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+// Report binary size, idle RSS and the best of several startup times
+void footprint(char *nanocom)
+{
+    struct stat st;
+    if (stat(nanocom, &st)) die("Can't stat %s: %s\n", nanocom, strerror(errno));
+    double best = 0;
+    long rss = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        int cm, tm, ts;
+        double start = now();
+        pid_t pid = launch(nanocom, "", false, &cm, &tm, &ts);
+        double t = now() - start;
+        if (!i || t < best) best = t;
+        if (!i)
+        {
+            // idle a moment, then get resident set size
+            usleep(250000);
+            char path[32], line[256];
+            sprintf(path, "/proc/%d/status", pid);
+            FILE *f = fopen(path, "r");
+            while (f && fgets(line, sizeof line, f)) if (sscanf(line, "VmRSS: %ld", &rss) == 1) break;
+            if (f) fclose(f);
+        }
+        quit(nanocom, pid, cm, tm, ts);
+    }
+    printf("%s: %ld bytes, %ld kB RSS when idle, %.1f mS from exec to connected\n", nanocom, (long)st.st_size, rss, best * 1000);
+}
+
+// Wait for byte c to arrive on fd, return seconds waited
+double await(int fd, char c, double start)
+{
+    while (1)
+    {
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        if (poll(&p, 1, 1000) <= 0) return 1;   // lost, count it as a second
+        char buf[256];
+        int n = read(fd, buf, sizeof buf);
+        if (n > 0 && memchr(buf, c, n)) return now() - start;
+    }
+}
+
+int compare(const void *a, const void *b) { return (*(double *)a > *(double *)b) - (*(double *)a < *(double *)b); }
+
+// Measure sorted latencies for single keys to target and single characters to console
+#define SAMPLES 500
+void measure(char *nanocom, double *tx, double *rx)
+{
+    int cm, tm, ts;
+    pid_t pid = launch(nanocom, "", false, &cm, &tm, &ts);
+    usleep(100000);                         // let the console go raw
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        double start = now();
+        write(cm, "k", 1);
+        tx[i] = await(tm, 'k', start);
+        start = now();
+        write(tm, "t", 1);
+        rx[i] = await(cm, 't', start);
+    }
+    quit(nanocom, pid, cm, tm, ts);
+    qsort(tx, SAMPLES, sizeof(double), compare);
+    qsort(rx, SAMPLES, sizeof(double), compare);
+}
+
+// Report latency percentiles
+void latency(char *nanocom)
+{
+    static double tx[SAMPLES], rx[SAMPLES];
+    measure(nanocom, tx, rx);
+    printf("%-20s %8s %8s %8s %8s\n", "latency uS", "p50", "p90", "p99", "max");
+    #define percentiles(name, a) printf("%-20s %8.0f %8.0f %8.0f %8.0f\n", name, a[SAMPLES/2]*1e6, a[SAMPLES*9/10]*1e6, a[SAMPLES*99/100]*1e6, a[SAMPLES-1]*1e6)
+    percentiles("key to target", tx);
+    percentiles("target to console", rx);
+}
+
+#define S(s) s, sizeof(s) - 1                  // string literal and its length, which may include NULs
+
+// Console output expected for target input, '#' in expect matches any digit
+struct
+{
+    char *name;                             // check name
+    char *options;                          // nanocom options, space separated
+    char *input; int inlen;                 // sent by target
+    char *expect; int explen;               // rendered on console, note the console pty adds CR before LF
+    bool tcp;                               // target is TCP loopback instead of a pty
+} checks[] = {
+    { "plain",      "",         S("a\rb\r\nc\n"),                    S("a\rb\r\r\nc\r\r\n") },
+    { "escapes",    "",         S("\e[1mbold\e[0m\r\n"),             S("\e[1mbold\e[0m\r\r\n") },
+    { "hex",        "-h",       S("\x01ok\xff\r\n"),                  S("[01]ok[FF][0D]\r\r\n") },
+    { "allhex",     "-H",       S("ab\r\n"),                          S("[61][62][0D][0A]") },
+    { "hexdump",    "-D",       S("hello world 0123"),
+                                S("00000000  68 65 6C 6C 6F 20 77 6F  72 6C 64 20 30 31 32 33  |hello world 0123|\r\r\n") },
+    { "utf8",       "-u",       S("caf\xc3\xa9 bad\xff\xc0\xaf\r\n"),   S("caf\xc3\xa9 bad[FF][C0][AF]\r\r\n") },
+    { "translit",   "-i",       S("\xc9\xcd\xbb\r\n"),                S("\xe2\x95\x94\xe2\x95\x90\xe2\x95\x97\r\r\n") },
+    { "timestamp",  "-s",       S("abc\r\ndef\r\n"),                  S("[##:##:##.###] abc\r\r\n[##:##:##.###] def\r\r\n") },
+    { "datestamp",  "-S",       S("abc\r\n"),                         S("[####-##-## ##:##:##.###] abc\r\r\n") },
+    { "telnet",     "-t",       S("x\xff\xff\xff\xf1y\r\n"),          S("x\xffy\r\r\n") },
+    { "telnetcr",   "-T",       S("x\r\0y\r\n"),                      S("x\ry\r\r\n") },
+    { "wrap",       "-w",       S("0123456789012345678901234567890123456789012345678901234567890123456789012345678901234\r\n"),
+                                S("01234567890123456789012345678901234567890123456789012345678901234567890123456789\r\r\n"
+                                  "01234\r\r\n") },
+    { "wrapstamp",  "-s -w",    S("0123456789012345678901234567890123456789012345678901234567890123456789012345678901234\r\n"),
+                                S("[##:##:##.###] 01234567890123456789012345678901234567890123456789012345678901234\r\r\n"
+                                  "               56789012345678901234\r\r\n") },
+    { "fold",       "-z",       S("same\r\nsame\r\nsame\r\nnext\r\n"),
+                                S("same\r\r\n| last line repeated 2 times\r\r\nnext\r\r\n") },
+    { "tcp",        "",         S("a\rb\r\nc\n"),                    S("a\rb\r\r\nc\r\r\n"), true },
+    { "tcptelnet",  "-t",       S("x\xff\xff\xff\xf1y\r\n"),          S("x\xffy\r\r\n"), true },
+    { "tcptelcr",   "-T",       S("x\r\0y\r\n"),                      S("x\ry\r\r\n"), true },
+};
+
+// Return true if count bytes of got match expect
+bool match(char *got, int count, char *expect, int explen)
+{
+    if (count != explen) return false;
+    for (int i = 0; i < count; i++)
+        if (expect[i] == '#' ? !isdigit((unsigned char)got[i]) : got[i] != expect[i]) return false;
+    return true;
+}
+
+// Print count bytes with C escapes
+void escaped(char *s, int count)
+{
+    for (int i = 0; i < count; i++)
+        if (s[i] == '\\' || s[i] == '"') printf("\\%c", s[i]);
+        else if (isprint((unsigned char)s[i])) putchar(s[i]);
+        else printf("\\x%02x", (unsigned char)s[i]);
+}
+
+// Check each display mode and latency limits, return the number of failures
+int test(char *nanocom)
+{
+    int failed = 0;
+    for (int c = 0; c < sizeof(checks) / sizeof(checks[0]); c++)
+    {
+        int cm, tm, ts;
+        pid_t pid = launch(nanocom, checks[c].options, checks[c].tcp, &cm, &tm, &ts);
+        usleep(100000);                     // let the console go raw
+        drain(cm, NULL);
+        write(tm, checks[c].input, checks[c].inlen);
+
+        // collect console output until quiet
+        char got[4096];
+        int n = 0;
+        while (n < sizeof got)
+        {
+            struct pollfd p = { .fd = cm, .events = POLLIN };
+            if (poll(&p, 1, 250) <= 0) break;
+            int r = read(cm, got + n, sizeof got - n);
+            if (r <= 0) break;
+            n += r;
+        }
+        quit(nanocom, pid, cm, tm, ts);
+
+        bool ok = match(got, n, checks[c].expect, checks[c].explen);
+        printf("%-10s %-9s %s\n", checks[c].name, checks[c].options, ok ? "ok" : "FAILED");
+        if (ok) continue;
+        failed++;
+        printf("  expected \""), escaped(checks[c].expect, checks[c].explen), printf("\"\n");
+        printf("  got      \""), escaped(got, n), printf("\"\n");
+    }
+
+    // p50 and p99 limits in uS, generous so a busy machine doesn't fail
+    static double tx[SAMPLES], rx[SAMPLES];
+    measure(nanocom, tx, rx);
+    struct { char *name; double *a; int p50, p99; } limits[] = {
+        { "key to target", tx, 2000, 20000 },
+        { "target to console", rx, 2000, 20000 },
+    };
+    for (int l = 0; l < 2; l++)
+    {
+        double p50 = limits[l].a[SAMPLES/2] * 1e6, p99 = limits[l].a[SAMPLES*99/100] * 1e6;
+        bool ok = p50 <= limits[l].p50 && p99 <= limits[l].p99;
+        printf("%-20s p50 %.0f uS, p99 %.0f uS, limits %d and %d: %s\n", limits[l].name, p50, p99, limits[l].p50, limits[l].p99, ok ? "ok" : "FAILED");
+        failed += !ok;
+    }
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    char report = 0;
+    while (1) switch (getopt(argc, argv, "fltm:"))
+    {
+        case 'f': report = 'f'; break;
+        case 'l': report = 'l'; break;
+        case 't': report = 't'; break;
+        case 'm': megs = atoi(optarg); if (megs <= 0) die("Invalid MB\n"); break;
+        case -1: goto optx;
+        default: die("Usage: bench [-f|-l|-t] [-m MB] [path/to/nanocom]\n");
+    } optx:
+    signal(SIGPIPE, SIG_IGN);
+    char *nanocom = (optind < argc) ? argv[optind] : "./nanocom";
+    if (report == 'f') footprint(nanocom);
+    if (report == 'l') latency(nanocom);
+    if (report == 't') return test(nanocom) ? 1 : 0;
+    if (report) return 0;
+
+    printf("%-10s %-9s %10s %10s\n", "stream", "option", "CPU mS/MB", "MB/S");
+    double cpus = 0, mbs = 0;
+    for (int s = 0; s < sizeof(streams) / sizeof(streams[0]); s++)
+    {
+        double wall, mb, cpu = run(nanocom, s, &wall, &mb);
+        cpus += cpu, mbs += mb;
+        printf("%-10s %-9s %10.1f %10.1f\n", streams[s].name, streams[s].options, cpu * 1000 / mb, mb / wall);
+    }
+    printf("%-10s %-9s %10.1f\n", "all", "", cpus * 1000 / mbs);
+    return 0;
+}
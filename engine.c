@@ -0,0 +1,169 @@
+// libnanocom session engine
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include "nanocom.h"
+
+struct nc_session
+{
+    int fd;                     // target, or -1 if not connected
+    queue tx;                   // queued for target
+    ring rx;                    // scrollback, if options.scrollback
+    nc_options options;         // copy of caller's options
+    render view;                // console renderer
+#if TELNET
+    void *telnet;               // telnet context, or NULL
+#endif
+};
+
+// Return new unconnected session
+nc_session *nc_new(nc_options *options)
+{
+    nc_session *s = calloc(1, sizeof(nc_session));
+    if (!s) abort();                                // abort on OOM
+    if (options) s->options = *options;
+    s->fd = -1;
+    if (s->options.scrollback > 0) initring(&s->rx, s->options.scrollback);
+    return s;
+}
+
+// Connect or reconnect
+int nc_connect(nc_session *s, char *target, char *error, int size)
+{
+    nc_disconnect(s);
+    int fd = open_target(target, s->options.native, s->options.dtr, error, size);
+    if (fd <= 0) return fd;
+    s->fd = fd;
+#if TELNET
+    if (s->options.telnet) s->telnet = init_telnet(&s->tx, s->options.telnet == 1, getenv("TERM") ?: "dumb");
+#endif
+    return 1;
+}
+
+// Connect and return new session
+nc_session *nc_open(char *target, nc_options *options, char *error, int size)
+{
+    nc_session *s = nc_new(options);
+    if (nc_connect(s, target, error, size) > 0) return s;
+    nc_close(s);
+    return NULL;
+}
+
+// Queue bytes for target
+void nc_send(nc_session *s, void *data, int count)
+{
+    nc_escape(s, &s->tx, data, count);
+}
+
+// Queue bytes with telnet escapes
+void nc_escape(nc_session *s, queue *q, void *data, int count)
+{
+#if TELNET
+    if (s->telnet)
+    {
+        // queue runs up to the next character that telnet needs to expand, as tx_telnet() would
+        unsigned char *c = data, *end = c + count;
+        while (c < end)
+        {
+            unsigned char *e = memchr(c, 255, end - c) ?: end; // IAC
+            if (s->options.telnet == 2)
+            {
+                unsigned char *cr = memchr(c, '\r', e - c); // CR in ASCII mode
+                if (cr) e = cr;
+            }
+            putq(q, c, e - c);
+            if (e < end) putq(q, (*e == '\r') ? (unsigned char []){'\r', 0} : (unsigned char []){255, 255}, 2);
+            c = e + (e < end);
+        }
+        return;
+    }
+#endif
+    putq(q, data, count);
+}
+
+// Read from target
+int nc_read(nc_session *s, unsigned char *data, int size)
+{
+    if (s->fd < 0) return -1;
+    int n = read(s->fd, data, size);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+    if (n <= 0) return -1;
+#if TELNET
+    if (s->telnet)
+    {
+        // strip telnet IACs in place
+        int m = 0;
+        for (int i = 0; i < n; i++) if (rx_telnet(s->telnet, data[i])) data[m++] = data[i];
+        n = m;
+    }
+#endif
+    if (s->rx.size) putring(&s->rx, data, n);
+    return n;
+}
+
+// Service target
+int nc_poll(nc_session *s, int timeout)
+{
+    if (s->fd < 0) return -1;
+    struct pollfd p = { .fd = s->fd, .events = availq(&s->tx) ? POLLIN|POLLOUT : POLLIN };
+    int r = poll(&p, 1, timeout);
+    if (r < 0) return (errno == EINTR) ? 0 : -1;
+    if (!r) return 0;
+
+    if (p.revents & POLLOUT && dequeue(&s->tx, s->fd) < 0 && errno != EAGAIN) goto closed;
+
+    if (!(p.revents & (POLLIN|POLLHUP|POLLERR))) return 0;
+    unsigned char bf[1024];
+    int n = nc_read(s, bf, sizeof bf);
+    if (n < 0) goto closed;
+    if (n && s->options.receive) s->options.receive(s->options.arg, bf, n);
+    if (n && s->view.conout) showrender(&s->view, bf, n);
+    return n;
+
+    closed:
+    nc_disconnect(s);
+    return -1;
+}
+
+int nc_fd(nc_session *s) { return s->fd; }
+
+queue *nc_queue(nc_session *s) { return &s->tx; }
+
+void *nc_telnet(nc_session *s)
+{
+#if TELNET
+    return s->telnet;
+#else
+    return NULL;
+#endif
+}
+
+ring *nc_ring(nc_session *s) { return s->rx.size ? &s->rx : NULL; }
+
+render *nc_render(nc_session *s) { return &s->view; }
+
+// Disconnect
+void nc_disconnect(nc_session *s)
+{
+    if (s->fd >= 0) close(s->fd);
+    s->fd = -1;
+    delq(&s->tx, -1);
+#if TELNET
+    free(s->telnet);
+    s->telnet = NULL;
+#endif
+}
+
+// Disconnect and free
+void nc_close(nc_session *s)
+{
+    nc_disconnect(s);
+    freeq(&s->tx);
+    freering(&s->rx);
+    freerender(&s->view);
+    free(s);
+}
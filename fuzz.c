@@ -0,0 +1,61 @@
+// Standalone driver for the fuzz targets, used instead of libFuzzer when it isn't available. Runs the target on each
+// input file given, or else on the given number of random inputs, biased towards the bytes nanocom treats specially.
+//
+// Usage: fuzzxxx [runs [seed]] | [file...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+unsigned int seed;
+
+// xorshift
+unsigned int randomly(void)
+{
+    seed ^= seed << 13, seed ^= seed >> 17, seed ^= seed << 5;
+    return seed;
+}
+
+int main(int argc, char *argv[])
+{
+    static uint8_t data[65536];
+
+    if (argc > 1 && !isdigit((unsigned char)*argv[1]))
+    {
+        // replay files
+        for (int f = 1; f < argc; f++)
+        {
+            FILE *fp = fopen(argv[f], "rb");
+            if (!fp) { perror(argv[f]); return 1; }
+            size_t size = fread(data, 1, sizeof data, fp);
+            fclose(fp);
+            fprintf(stderr, "%s: %zu bytes\n", argv[f], size);
+            LLVMFuzzerTestOneInput(data, size);
+        }
+        return 0;
+    }
+
+    int runs = (argc > 1) ? atoi(argv[1]) : 10000;
+    seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : time(NULL);
+    if (!seed) seed = 1;
+    fprintf(stderr, "%d runs, seed %u\n", runs, seed);
+
+    static const uint8_t special[] = "\r\n\t\b\e\e[;?0123456789mHJKr\x7f\x80\xbf\xc0\xc3\xe2\x95\xef\xf0\xf1\xff";
+    for (int r = 0; r < runs; r++)
+    {
+        size_t size = randomly() % ((r & 15) ? 256 : 4096);  // mostly short, some long
+        for (size_t i = 0; i < size; i++)
+        {
+            unsigned int x = randomly();
+            data[i] = (x & 1) ? special[(x >> 8) % (sizeof special - 1)] : x >> 16;
+        }
+        LLVMFuzzerTestOneInput(data, size);
+    }
+    fprintf(stderr, "ok\n");
+    return 0;
+}
@@ -0,0 +1,219 @@
+// Fuzz target for the console renderer, i.e. showrender() in each display mode. The input is a series of operations:
+// a byte below 0xF0 shows that many plus one of the following bytes as target output, the others toggle a display
+// mode as nanocom's command menu would, set the console width, start and stop FX command output, or go idle.
+//
+// Inputs with an odd first byte only toggle hex, all-hex, CP437 encoding and wrapping, and their tee output must match
+// reference(), a byte-at-a-time model of the renderer in those modes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "render.h"
+#if TRANSLIT
+#include "translit.h"
+#endif
+
+// Growable output buffer
+typedef struct
+{
+    unsigned char *data;
+    size_t len, size;
+} output;
+
+static void append(output *o, const void *data, size_t count)
+{
+    if (o->len + count > o->size)
+    {
+        o->size = (o->len + count) * 2;
+        o->data = realloc(o->data, o->size);
+        if (!o->data) abort();
+    }
+    memcpy(o->data + o->len, data, count);
+    o->len += count;
+}
+
+// Renderer outputs, the tee is kept for the check
+static void discard(void *arg, const void *data, int count) {}
+static void keep(void *arg, const void *data, int count) { append(arg, data, count); }
+static int width(void *arg) { return 80; }
+
+// Reference renderer state, as the tee sees it
+static struct
+{
+    int dirty;                  // 0 = clean, 1 = dirty, 2 = dirty with deferred CR
+    int escstate;               // 0 = none, 1 = after ESC, 2 = in CSI, 3 = in string, 4 = ESC in string
+} ref;
+
+// Put c to the reference tee as "[XX]"
+static void refhex(output *o, int c)
+{
+    char s[5];
+    sprintf(s, "[%02X]", c);
+    append(o, s, 4);
+    ref.dirty = 1;
+}
+
+// Put the deferred CR to the reference tee, as LF
+static void refcr(output *o)
+{
+    if (ref.dirty > 1) append(o, "\n", 1);
+}
+
+// Render character c to the reference tee, with showhex 0 to 2 and encode
+static void reference(output *o, int c, int showhex, bool encode)
+{
+    switch (ref.escstate)
+    {
+        case 1:                                     // after ESC
+            if (c < 32) break;                      // broken, c is handled below
+            append(o, (unsigned char []){ c }, 1);
+            if (c == '[') ref.escstate = 2;
+            else if (strchr("]PX^_", c)) ref.escstate = 3;
+            else if (c >= 48)
+            {
+                if (strchr("78DEM", c)) ref.dirty = 1; // moves the cursor
+                ref.escstate = 0;
+            }
+            return;
+
+        case 2:                                     // CSI
+            if (c < 32 || c > 126) break;           // broken
+            append(o, (unsigned char []){ c }, 1);
+            if (c < 64) return;                     // parameter or intermediate
+            if ((c >= 'A' && c <= 'H') || strchr("adef`", c)) ref.dirty = 1;
+            ref.escstate = 0;
+            return;
+
+        case 3:                                     // string
+            append(o, (unsigned char []){ c }, 1);
+            if (c == 7) ref.escstate = 0;
+            else if (c == 27) ref.escstate = 4;
+            return;
+
+        case 4:                                     // ESC in string
+            ref.escstate = 0;
+            if (c != '\\') break;
+            append(o, (unsigned char []){ c }, 1);
+            return;
+    }
+    ref.escstate = 0;
+
+    if (showhex > 1) { refhex(o, c); return; }
+    switch (c)
+    {
+        case 10:                                    // LF
+            append(o, "\n", 1);
+            ref.dirty = 0;
+            return;
+
+        case 13:                                    // CR
+            if (showhex) refhex(o, c);
+            else if (ref.dirty) ref.dirty = 2;
+            return;
+
+        case 27:                                    // ESC
+            if (showhex) { refhex(o, c); return; }
+            refcr(o);
+            if (ref.dirty > 1) ref.dirty = 0;
+            append(o, (unsigned char []){ c }, 1);
+            ref.escstate = 1;
+            return;
+
+        case 9:                                     // TAB, FF
+        case 12:
+            if (showhex) { refhex(o, c); return; }
+            // fall through
+        case 8:                                     // BS
+        case 32 ... 126:
+            refcr(o);
+            append(o, (unsigned char []){ c }, 1);
+            ref.dirty = 1;
+            return;
+
+        case 128 ... 255:
+            if (showhex) { refhex(o, c); return; }
+            refcr(o);
+#if TRANSLIT
+            if (encode) append(o, cp437str + cp437[c & 127].offset, cp437[c & 127].length);
+            else
+#endif
+            append(o, (unsigned char []){ c }, 1);
+            ref.dirty = 1;
+            return;
+
+        default:                                    // other controls only show as hex
+            if (showhex) refhex(o, c);
+            return;
+    }
+}
+
+// Make the reference cursor clean, as flushrender() does
+static void refflush(output *o)
+{
+    if (ref.dirty) append(o, "\n", 1);
+    ref.dirty = 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static output tee, model;
+    bool check = size && (data[0] & 1);             // use only the modes reference() knows
+
+    // start each input with a fresh renderer in the default modes
+    render r = { .conout = discard, .teeout = keep, .columns = width, .arg = &tee };
+    tee.len = model.len = 0;
+    ref.dirty = ref.escstate = 0;
+
+    for (size_t i = 0; i < size; )
+    {
+        int op = data[i++];
+        if (op < 0xF0)
+        {
+            int n = (op + 1 < size - i) ? op + 1 : size - i;
+            showrender(&r, (unsigned char *)data + i, n);
+            if (check) for (int j = 0; j < n; j++) reference(&model, data[i + j], r.showhex, r.encode);
+            i += n;
+            continue;
+        }
+        switch (op)
+        {
+            case 0xF0: if (i < size) r.cols = (data[i] < 2) ? 0 : data[i], i++; break; // console width, 0 is unknown
+            case 0xF1: if (!check) flushrender(&r), r.fx = !r.fx; break;
+            case 0xF2: idlerender(&r); break;
+            default:
+            {
+                // command menu toggle, nanocom flushes before showing the menu
+                int t = "hHDisSuwz"[(op - 0xF3) % 9];
+                if (check && strchr("DsSuz", t)) break;
+                flushrender(&r);
+                refflush(&model);
+                switch (t)
+                {
+                    case 'h': r.showhex = !r.showhex; break;
+                    case 'H': r.showhex = (r.showhex != 2) * 2; break;
+                    case 'D': r.showhex = (r.showhex != 3) * 3; break;
+                    case 'i': if (r.encode || charsetrender(&r)) r.encode = !r.encode; break;
+                    case 's': r.timestamp = !r.timestamp; break;
+                    case 'S': r.timestamp = (r.timestamp != 2) * 2; break;
+                    case 'u': r.utf8 = !r.utf8; break;
+                    case 'w': r.wrap = !r.wrap; break;
+                    case 'z': r.folding = !r.folding; break;
+                }
+                break;
+            }
+        }
+    }
+    flushrender(&r);
+    freerender(&r);
+    refflush(&model);
+
+    if (check && (tee.len != model.len || memcmp(tee.data, model.data, tee.len)))
+    {
+        size_t n = 0;
+        while (n < tee.len && n < model.len && tee.data[n] == model.data[n]) n++;
+        fprintf(stderr, "tee differs from reference at byte %zu of %zu, expected %zu bytes\n", n, tee.len, model.len);
+        abort();
+    }
+    return 0;
+}
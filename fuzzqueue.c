@@ -0,0 +1,124 @@
+// Differential fuzz target for queue.c. Each input byte is an operation on a queue and on a flat buffer model of it,
+// and the queue's contents must always match the model.
+
+#define _GNU_SOURCE // for pipe2()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "queue.h"
+
+#define MODEL (1 << 20)                 // most bytes the model holds
+
+// Report and abort if not ok
+#define check(ok, why) if (!(ok)) fprintf(stderr, "queue %s after %zu operations\n", why, op), abort()
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static uint8_t *model, buf[4096];
+    static int pipes[2];
+    static unsigned char next;          // next byte value to put
+    if (!model)
+    {
+        model = malloc(MODEL);
+        if (!model || pipe2(pipes, O_NONBLOCK)) abort();
+    }
+
+    queue q = {0};
+    int first = 0, count = 0;           // model bytes are at model + first
+    size_t op;
+    for (op = 0; op < size; op++)
+    {
+        int n = data[op] >> 3;          // operation size
+        n = n * n * 4;                  // up to 3844, so the queue grows and wraps
+        switch (data[op] & 7)
+        {
+            case 0:
+            case 1:
+                // putq
+                if (count + n > MODEL) break;
+                if (first + count + n > MODEL) memmove(model, model + first, count), first = 0;
+                for (int i = 0; i < n; i++) buf[i] = next++;
+                putq(&q, buf, n);
+                memcpy(model + first + count, buf, n);
+                count += n;
+                break;
+
+            case 2:
+            case 3:
+            {
+                // getq and delq part of it
+                void *p;
+                int len = getq(&q, &p);
+                check(len <= count && (len || !count), "getq length is wrong");
+                if (n > len) n = len;
+                if (!n) break;
+                check(!memcmp(p, model + first, n), "getq data is wrong");
+                delq(&q, n);
+                first += n, count -= n;
+                break;
+            }
+
+            case 4:
+                // delq everything
+                if (n) break;           // only sometimes
+                delq(&q, -1);
+                first = count = 0;
+                break;
+
+            case 5:
+            {
+                // dequeue to pipe, and check what comes out
+                int w = dequeue(&q, pipes[1]);
+                if (w <= 0) break;
+                for (int got = 0; got < w; )
+                {
+                    int r = read(pipes[0], buf, (w - got < sizeof buf) ? w - got : sizeof buf);
+                    check(r > 0, "dequeue wrote too much");
+                    check(!memcmp(buf, model + first + got, r), "dequeue data is wrong");
+                    got += r;
+                }
+                first += w, count -= w;
+                break;
+            }
+
+            case 6:
+            {
+                // enqueue from pipe
+                if (count + 256 > MODEL) break;
+                if (first + count + 256 > MODEL) memmove(model, model + first, count), first = 0;
+                n %= 256;
+                for (int i = 0; i < n; i++) buf[i] = next++;
+                if (write(pipes[1], buf, n) != n) abort();
+                int r = enqueue(&q, pipes[0]);
+                check(r == (n ? n : -1), "enqueue read the wrong amount");
+                if (r > 0) memcpy(model + first + count, buf, r), count += r;
+                break;
+            }
+
+            case 7:
+                // free the buffer, the next putq starts over
+                if (n) break;           // only sometimes
+                freeq(&q);
+                first = count = 0;
+                break;
+        }
+        check(availq(&q) == count, "count is wrong");
+    }
+
+    // drain and compare everything that's left
+    void *p;
+    int len, at = 0;
+    while ((len = getq(&q, &p)))
+    {
+        check(at + len <= count && !memcmp(p, model + first + at, len), "contents are wrong");
+        at += len;
+        delq(&q, len);
+    }
+    check(at == count, "lost data");
+    freeq(&q);
+    return 0;
+}
@@ -19,10 +19,19 @@ char *usage = "Usage:\n"
               "\n"
               "Options:\n"
               "\n"
+#if SESSION
+              "    -a path     - attach to the session on Unix socket path, no target is given\n"
+              "    -A path     - run as a detachable session on Unix socket path\n"
+#endif
               "    -b          - backspace key sends DEL instead of BS\n"
+              "    -B          - show status bar on bottom line of console\n"
+              "    -C path     - accept control connections on Unix socket path, to send, expect and query\n"
               "    -d          - toggle serial port DTR high on start\n"
+              "    -D          - display all characters as hexdump\n"
               "    -e          - enter key sends LF instead of CR\n"
+              "    -E          - edit lines locally, send them when enter is pressed\n"
               "    -f file     - log console output to specified file\n"
+              "    -G file     - trace events, written to file as Chrome trace JSON on exit or SIGUSR2\n"
               "    -h          - display unprintable characters as hex\n"
               "    -H          - display all characters as hex\n"
 #if TRANSLIT
@@ -32,10 +41,21 @@ char *usage = "Usage:\n"
               "    -k          - enable key lock\n"
               "    -l mS       - flush characters after first connect until idle for specified mS\n"
               "    -L mS       - also flush on reconnect\n"
+              "    -m cps      - limit console to cps characters per second, skip the excess\n"
+              "    -M kB       - keep kB of console output in memory for searching\n"
               "    -n          - don't force target tty to 115200 N-8-1\n"
+              "    -p mS[,mS]  - pace keys sent to target, mS after each character and optionally each line\n"
+              "    -p echo     - pace keys sent to target, wait for each character to be echoed\n"
+              "    -o path     - mirror console to tty, pty or fifo, 'path:kB' to queue more than 64 kB\n"
+              "    -O command  - pipe console output to command's stdin, its output should be redirected\n"
+              "    -P command  - pipe raw target output to command's stdin, its output should be redirected\n"
               "    -r          - try to reconnect target if it won't open or closes with error\n"
               "    -s          - display timestamps\n"
               "    -S          - display date+timestamps\n"
+              "    -u          - display high-bit characters as UTF-8, invalid sequences as hex\n"
+              "    -W          - stop reading target while the pipe command is behind, instead of dropping\n"
+              "    -w          - wrap long lines on console, continuation lines are indented under timestamp\n"
+              "    -y target   - also send keys to target, may be repeated to broadcast to a fleet\n"
 #if TELNET
               "    -t          - enable telnet in binary mode\n"
               "    -T          - enable telnet in ASCII mode (handles CR+NUL)\n"
@@ -44,19 +64,20 @@ char *usage = "Usage:\n"
               "    -x command  - execute FX command after first connect\n"
               "    -X command  - also execute on reconnect\n"
 #endif
+              "    -z          - fold repeated lines on console\n"
+              "    -Z          - also fold repeated lines in log file\n"
               "\n"
               "Once connected, press key ^\\ for a menu of command options. Many of the settings\n"
               "above can be toggled there.\n"
               "\n"
               ;
 
-#ifdef FXCMD
-#define _GNU_SOURCE // for pipe2()
-#endif
+#define _GNU_SOURCE // for pipe2(), accept4() and memmem()
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/signal.h>
@@ -69,22 +90,18 @@ char *usage = "Usage:\n"
 #include <time.h>
 #include <ctype.h>
 #include <sys/wait.h>
-#if NETWORK
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/socket.h>
-#include <netdb.h>
-#endif
+#include <sys/un.h>
 #include <poll.h>
-#if TRANSLIT
-#include <iconv.h>
-#include <locale.h>
-#endif
 #if FXCMD
 #include <pty.h>
 #endif
 
-#include "queue.h"
-#if TELNET
-#include "telnet.h"
+#include "nanocom.h"             // queue, ring, target, telnet and render from libnanocom
+#if SESSION
+#include "session.h"
 #endif
 
 // ASCII controls of interest
@@ -103,46 +120,57 @@ char *usage = "Usage:\n"
 char *targetname;               // target name, eg "/dev/ttyX" or "host:port"
 char *teename = NULL;           // tee file name
 bool reconnect = false;         // true = reconnect after failure
-int showhex = 0;                // 1 = show received unprintable as hex, 2 = show all as hex
+bool statusbar = false;         // true = show status bar on bottom row of console
+int scrollsize = 0;             // kB of console output to keep for searching, 0 = none
+bool lineedit = false;          // true = edit lines locally and send them when enter is pressed
+bool pacing = false;            // true = send characters to target one at a time, see pacetime()
+int chardelay = 0;              // mS to pause after each paced character
+int linedelay = 0;              // mS to pause after each paced CR or LF
+bool echosync = false;          // true = wait for each paced character to be echoed
 bool enterkey = false;          // true = enter key sends LF instead of CR
 bool bskey = false;             // true = send DEL for BS
 bool native = false;            // true = don't force serial 115200 N81
-int timestamp = 0;              // 1 = show time, 2 = show date and time
 bool dtr = false;               // true = twiddle serial DTR on connect
 int flush = 0;                  // mS to flush characters after connect
 bool reflush = false;           // true if flush on reconnect
 
-#if TRANSLIT
-bool encode = false;            // true = enable encoding
-char *charset = NULL;           // iconv character set, default "CP437"
-#endif
 #if TELNET
 int telnet = 0;                 // 0=disabled, 1=binary, 2=ascii
-void *tctx = NULL;              // telnet context
 #endif
 #if FXCMD
 char *start = NULL;             // initial FX command to run
 bool restart = false;           // true if also run on reconnect
 #endif
+#if SESSION
+char *sessionname = NULL;       // session socket path
+char *attachname = NULL;        // session socket path to attach to
+#endif
 
 // Other globals
 bool keylock = false;
-int target = 0;                 // target device or socket, if > 0
+nc_session *session;            // target connection, see doconnect()
+nc_options ncoptions;           // options for session and fleet, from the command line
+render *view;                   // session's console renderer, with the display options
+int target = 0;                 // session's file descriptor, if > 0
 int teefd = 0;                  // tee file descriptor, if > 0
 struct termios cooked;          // initial cooked console termios
 #if FXCMD
 char *running = NULL;           // name of currently running FX command or NULL, affects display() and command()
 #endif
+unsigned char *sendmap = NULL;  // mmap'd file being sent to target, see sendmore()
+size_t sendsize, sent;          // size of sendmap and bytes sent so far
 
 #define console STDOUT_FILENO   // console is stdout
 
 // Console modes for display()
 #define COOKED -1               // COOKED, set whatever state the console was in to start with
 #define WARM -2                 // COOKED without ISIG, for user input
-#define RAW -3                  // RAW, all characters must be sent via display()
+#define RAW -3                  // RAW, all characters must be sent via show()
 #define RECOOK -4               // restore COOKED if not already
+#define IDLE -5                 // not a mode, target is idle so show pending output
 
-void display(int c);            // write character to raw console or set console mode
+void display(int c);            // set console mode
+void show(unsigned char *s, int count); // write characters to raw console
 
 // restore console, registered with atexit()
 void recook(void) { display(RECOOK); }
@@ -152,13 +180,95 @@ void recook(void) { display(RECOOK); }
 
 #define bytes(...) (unsigned char []){__VA_ARGS__}  // define an array of bytes
 
-queue qtarget = {0};            // queued data to be sent to target
+queue *qtarget;                 // queued data to be sent to target, the session's queue
+queue qsend = {0};              // queued file data, sent when qtarget is empty, see sendmore()
+
+// Event trace, see -G. Fixed-size events are recorded in a ring and written as Chrome trace JSON, for Perfetto or
+// chrome://tracing, on exit or SIGUSR2.
+#define TRACES 65536            // events kept, older events are overwritten
+enum { TREAD, TSEND, TKEY, TWRITE, TCONNECT, TFAIL, TLOST, TFX };
+struct
+{
+    char *name;                 // event name
+    int track;                  // 1 = target, 2 = console, 3 = FX command
+} tracetypes[] = {
+    [TREAD]     = { "target read", 1 },
+    [TSEND]     = { "target write", 1 },
+    [TKEY]      = { "key", 2 },
+    [TWRITE]    = { "console write", 2 },
+    [TCONNECT]  = { "connect", 1 },
+    [TFAIL]     = { "connect failed", 1 },
+    [TLOST]     = { "lost connection", 1 },
+    [TFX]       = { "FX command", 3 },
+};
+struct event
+{
+    long long start;            // uS
+    int duration;               // uS, or -1 if instant
+    short type;                 // TREAD etc
+    int size;                   // bytes
+} *traces = NULL;               // malloced ring, if tracing
+char *tracename = NULL;         // JSON file
+unsigned long ntraces = 0;      // events recorded
+volatile sig_atomic_t tracedump = 0; // set by SIGUSR2
+
+// Return monotonic uS
+long long ustime(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000LL + t.tv_nsec / 1000;
+}
+
+// Record an event of specified type and size, which started at start uS or, if start is 0, is instant
+#define trace(type, size, start) if (traces) addtrace(type, size, start)
+void addtrace(int type, int size, long long start)
+{
+    long long now = ustime();
+    traces[ntraces++ % TRACES] = (struct event){ .start = start ?: now, .duration = start ? now - start : -1, .type = type, .size = size };
+}
+
+// Write trace ring to tracename as JSON, registered with atexit()
+void writetrace(void)
+{
+    tracedump = 0;
+    FILE *f = fopen(tracename, "w");
+    if (!f) return;
+    fprintf(f, "{\"traceEvents\":[");
+    char *sep = "\n";                                  // before each record
+    for (int t = 1; t <= 3; t++, sep = ",\n")
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", sep, t, (char *[]){"", "target", "console", "FX command"}[t]);
+    for (unsigned long n = (ntraces > TRACES) ? ntraces - TRACES : 0; n < ntraces; n++)
+    {
+        struct event *e = &traces[n % TRACES];
+        fprintf(f, "%s{\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%lld,", sep, tracetypes[e->type].name, tracetypes[e->type].track, e->start);
+        if (e->duration < 0) fprintf(f, "\"ph\":\"i\",\"s\":\"t\",");
+        else fprintf(f, "\"ph\":\"X\",\"dur\":%d,", e->duration);
+        fprintf(f, "\"args\":{\"bytes\":%d}}", e->size);
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(f);
+}
+
+void set_tracedump(int sig) { tracedump = 1; }
+
+// Start tracing
+void starttrace(void)
+{
+    if (!tracename) return;
+    traces = malloc(TRACES * sizeof(struct event));
+    if (!traces) abort();                               // abort on OOM
+    atexit(writetrace);
+    sigaction(SIGUSR2, &(struct sigaction){ .sa_handler = set_tracedump, .sa_flags = SA_RESTART }, NULL);
+}
 
 // Put character(s) to file descriptor, if size is 0 use strlen(s). Return -1 on unrecoverable error.
 int put(int fd, const void *s, size_t size)
 {
     if (!s) return 0;             // ignore NULL
     if (!size) size = strlen(s);
+    long long start = (traces && fd == console) ? ustime() : 0; // trace console writes, to see blocking
+    int count = size;
     while (size)
     {
         int n = write(fd, s, size);
@@ -166,6 +276,7 @@ int put(int fd, const void *s, size_t size)
         size -= n;
         s += n;
     }
+    if (start) addtrace(TWRITE, count, start);
     return 0;
 }
 
@@ -177,12 +288,21 @@ int put(int fd, const void *s, size_t size)
 int await(int fd, int events, int timeout)
 {
     struct pollfd p = { .fd = fd, .events = events };
-    int r = poll(&p, 1, timeout);
+    int r;
+    while ((r = poll(&p, 1, timeout)) < 0 && errno == EINTR); // ignore SIGWINCH
     if (!r) return 0;
     if (r == 1 && p.revents & events) return p.revents & events;
     return -1;
 }
 
+// Return monotonic time in mS
+long long mstime(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000LL + t.tv_nsec / 1000000;
+}
+
 // Return character from raw console, 0 if timeout, or die
 int key(int timeout)
 {
@@ -196,115 +316,350 @@ int key(int timeout)
     die("Console error: %s\n", strerror(errno));
 }
 
-// Given one of the modes above, configure the console. Or given a character in RAW mode, display the character with
-// timestamps, high-character encoding, hex conversion, and mirror to teefile if enabled.
-void display(int c)
+// Console mirrors, additional ttys, ptys or fifos that receive a copy of rendered console output. Each has its
+// own queue, output that doesn't fit is dropped so a stuck mirror never stalls the console.
+#define MIRRORS 8               // maximum number of mirrors
+#define MIRRORKB 64             // default mirror queue limit
+struct
 {
-    // Current mode, 0 if uninitialized
-    static int mode = 0;
-
-#if TRANSLIT
-    // unicode sequences for high-bit characters
-    static char *translit[128];
-#endif
+    char *name;                 // mirror path
+    int fd;                     // file descriptor, if > 0
+    int limit;                  // maximum bytes to queue
+    queue q;                    // pending output
+    long long opened;           // mstime() of last open attempt
+    unsigned long dropped;      // bytes dropped since last report
+    unsigned long lost;         // total bytes dropped
+} mirrors[MIRRORS];
+int nmirrors = 0;
+
+// Parse "path[:kB]" and add a mirror
+void addmirror(char *arg)
+{
+    if (nmirrors >= MIRRORS) die("Too many mirrors\n");
+    char *k = strrchr(arg, ':');
+    int kb = MIRRORKB;
+    if (k) *k++ = 0, kb = atoi(k);
+    if (!*arg || kb <= 0) die("Invalid mirror %s\n", arg);
+    mirrors[nmirrors++] = (typeof(mirrors[0])){ .name = arg, .limit = kb * 1024 };
+}
 
-    // RAW cursor state: 0=clean, 1=dirty, 2=dirty with deferred CR
-    static int dirty = 0;
+// Close a mirror, it will be reopened when there is more output
+void closemirror(int m)
+{
+    if (mirrors[m].fd > 0) close(mirrors[m].fd);
+    mirrors[m].fd = 0;
+    mirrors[m].dropped += availq(&mirrors[m].q);
+    mirrors[m].lost += availq(&mirrors[m].q);
+    delq(&mirrors[m].q, -1);
+}
 
-    // put to console and maybe tee
-    void putcon(const void *s, size_t size)
+// Copy rendered console output to all mirrors
+void mirror(const void *s, size_t size)
+{
+    for (int m = 0; m < nmirrors; m++)
     {
-        put(console, s, size);
-        if (teefd) put(teefd, s, size);
+        if (mirrors[m].fd <= 0)
+        {
+            // not open, try again at most once per second, a fifo can't be opened until it has a reader
+            long long now = mstime();
+            if (now - mirrors[m].opened >= 1000)
+            {
+                mirrors[m].opened = now;
+                int fd = open(mirrors[m].name, O_WRONLY|O_NONBLOCK|O_NOCTTY|O_CLOEXEC);
+                if (fd > 0) mirrors[m].fd = fd;
+            }
+        }
+        if (mirrors[m].fd <= 0 || availq(&mirrors[m].q) + size > mirrors[m].limit)
+        {
+            mirrors[m].dropped += size;
+            mirrors[m].lost += size;
+            continue;
+        }
+        if (mirrors[m].dropped && !availq(&mirrors[m].q))
+        {
+            // caught up, report the gap
+            char s[64];
+            int n = snprintf(s, sizeof s, "\r\n| Mirror dropped %lu bytes\r\n", mirrors[m].dropped);
+            putq(&mirrors[m].q, s, n);
+            mirrors[m].dropped = 0;
+        }
+        putq(&mirrors[m].q, (void *)s, size);
+        if (dequeue(&mirrors[m].q, mirrors[m].fd) < 0 && errno != EAGAIN) closemirror(m);
     }
+}
 
-    // put start of new line
-    void startline(void)
+// Add a pollfd for each mirror, POLLOUT if it has pending output. Return number added.
+int pollmirrors(struct pollfd *p)
+{
+    for (int m = 0; m < nmirrors; m++)
+        p[m] = (struct pollfd){ .fd = (mirrors[m].fd > 0 && availq(&mirrors[m].q)) ? mirrors[m].fd : -1, .events = POLLOUT };
+    return nmirrors;
+}
+
+// Send pending output to writable mirrors, after poll()
+void flushmirrors(struct pollfd *p)
+{
+    for (int m = 0; m < nmirrors; m++)
+        if (p[m].revents && dequeue(&mirrors[m].q, mirrors[m].fd) < 0 && errno != EAGAIN) closemirror(m);
+}
+
+// Pipe sink, a command that is started once and fed rendered console output (-O) or raw target output (-P) on its
+// stdin. Output that doesn't fit the queue is dropped, or with -W the target isn't read until the command catches up.
+#define PIPEKB 64               // pipe queue limit
+char *pipecmd = NULL;           // command, if not NULL
+bool piperaw = false;           // true = feed raw target output
+bool pipewait = false;          // true = stop reading target instead of dropping
+int pipefd = 0;                 // write end of the command's stdin, if > 0
+pid_t pipepid = 0;              // command pid, until reaped
+bool pipedead = false;          // true if the command stopped reading, closepipe() from the main loop
+queue pipeq = {0};              // pending output
+unsigned long pipelost = 0;     // total bytes dropped
+
+// Start the pipe command, its stdout and stderr go to /dev/null unless redirected
+void startpipe(void)
+{
+    if (!pipecmd) return;
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC)) die("Can't create pipe: %s\n", strerror(errno));
+    pipepid = fork();
+    if (pipepid < 0) die("Can't fork: %s\n", strerror(errno));
+    if (!pipepid)
     {
-#if FXCMD
-        if (running) { putcon("| ", 0); dirty = 1; }        // indicate FX command output
-#endif
-        if (!timestamp) return;
-        struct timeval t;
-        gettimeofday(&t, NULL);                             // get current time
-        struct tm *l = localtime(&t.tv_sec);
-        char s[40];                                         // format it
-        sprintf(s + strftime(s, sizeof(s)-10, (timestamp) > 1 ?  "[%Y-%m-%d %H:%M:%S": "[%H:%M:%S", l),".%.3d] ", (int)t.tv_usec/1000);
-        putcon(s, 0);
-        dirty = 1;
+        // child
+        int null = open("/dev/null", O_RDWR);
+        dup2(fds[0], 0);
+        dup2(null, 1);
+        dup2(null, 2);
+        setsid();                               // don't get the console's signals
+        execl("/bin/sh", "sh", "-c", pipecmd, NULL);
+        _exit(127);
     }
+    close(fds[0]);
+    pipefd = fds[1];
+    nonblocking(pipefd);
+}
+
+// Close pipe after the command exits. Not safe while rendering, pipeout() just sets pipedead.
+void closepipe(void)
+{
+    close(pipefd);
+    pipefd = 0;
+    pipedead = false;
+    pipelost += availq(&pipeq);
+    delq(&pipeq, -1);
+    display(WARM);
+    printf("| Pipe command '%s' has exited.\n", pipecmd);
+    display(RAW);
+}
 
-    void putLF(void)
+// Feed output to pipe command
+void pipeout(const void *s, size_t size)
+{
+    if (pipefd <= 0 || pipedead) return;
+    if (!pipewait && availq(&pipeq) + size > PIPEKB * 1024)
     {
-        put(console, bytes(CR, LF), 2);                     // CRLF to console
-        if (teefd) put(teefd, bytes(LF), 1);                // LF to the tee
-        dirty = 0;                                          // not dirty
+        pipelost += size;
+        return;
     }
+    putq(&pipeq, (void *)s, size);
+    if (dequeue(&pipeq, pipefd) < 0 && errno != EAGAIN) pipedead = true;
+}
+
+// True if target shouldn't be read because the pipe command is behind, see -W
+#define pipefull() (pipewait && availq(&pipeq) >= PIPEKB * 1024)
+
+// Add a pollfd for the pipe, POLLOUT if it has pending output or is dead (so poll() returns at once). Return number
+// added.
+int pollpipe(struct pollfd *p)
+{
+    *p = (struct pollfd){ .fd = (pipefd > 0 && (availq(&pipeq) || pipedead)) ? pipefd : -1, .events = POLLOUT };
+    return 1;
+}
+
+// Send pending output to the pipe, after poll(). Close it if the command stopped reading, and reap the command once
+// it exits.
+void flushpipe(struct pollfd *p)
+{
+    if (p->revents && !pipedead && dequeue(&pipeq, pipefd) < 0 && errno != EAGAIN) pipedead = true;
+    if (pipedead) closepipe();
+    if (pipepid > 0 && pipefd <= 0 && waitpid(pipepid, NULL, WNOHANG)) pipepid = 0; // exited, or -1 if already gone
+}
 
-    void putCR(void)
+ring scrollback = {0};          // tee output is also kept here for searching, if initialized
+
+// Local line editor state, see editline(). Console output is held while a line is being edited, but the tee and
+// scrollback aren't.
+#define EDITMAX 256             // longest line
+#define HISTORY 16              // number of lines remembered
+#define HOLDMAX 65536           // most bytes held, the main loop shows them when there are more
+char *history[HISTORY];         // sent lines, newest first
+int histlen = 0;                // number of lines in history
+char editbuf[EDITMAX + 2];      // line being edited
+int editlen = -1;               // length of line in editbuf, -1 if not editing
+int edith;                      // history line in editbuf, -1 if none
+bool holding = false;           // true = hold console output
+queue editheld = {0};           // console output held while editing
+
+// Write to console, mirrors and console pipe, or hold it
+void conwrite(const void *s, size_t size)
+{
+    if (holding)
     {
-        put(console, bytes(CR), 1);                         // CR to the console
-        if (teefd) put(teefd, bytes(LF), 1);                // but LF to the tee
-        startline();                                        // maybe (re)timestamp
+        putq(&editheld, (void *)s, size);
+        return;
     }
+    mirror(s, size);
+    if (!piperaw) pipeout(s, size);
+    put(console, s, size);
+}
+
+// Stop holding console output and write what was held
+void unhold(void)
+{
+    holding = false;
+    void *held;
+    for (int n; (n = getq(&editheld, &held)); delq(&editheld, n)) conwrite(held, n);
+}
+
+// Draw the edit line
+void drawedit(void)
+{
+    char s[EDITMAX + 16];
+    put(console, s, sprintf(s, "\r| > %.*s\e[K", editlen, editbuf));
+}
+
+// Renderer outputs, see main()
+void rendercon(void *arg, const void *s, int count) { conwrite(s, count); }
 
-    int puthex(int c)
+// Tee output goes to the tee file, and scrollback for searching
+void rendertee(void *arg, const void *s, int count)
+{
+    if (teefd) put(teefd, s, count);
+    putring(&scrollback, (void *)s, count);
+}
+
+// Return console width for wrapping, 0 if unknown
+int rendercols(void *arg)
+{
+    struct winsize ws;
+    return (ioctl(console, TIOCGWINSZ, &ws) || ws.ws_col < 2) ? 0 : ws.ws_col;
+}
+
+// Current console mode, 0 if uninitialized
+int conmode = 0;
+
+// Status bar state
+#define STATUSTIME 500          // mS between status bar updates
+int statusrows = 0;             // console rows when scroll region was set, 0 if status bar is not shown
+long long statustime = 0;       // mstime() of last update
+unsigned long rxbytes = 0;      // total bytes received from target
+unsigned long txbytes = 0;      // total bytes sent to target
+unsigned long rxlast, txlast;   // totals at last update
+char statusline[256];           // status text currently shown
+
+// Remove status bar, if shown
+void nostatus(void)
+{
+    if (!statusrows) return;
+    char s[32];
+    put(console, s, sprintf(s, "\e7\e[r\e[%d;1H\e[K\e8", statusrows)); // reset scroll region and clear bottom row
+    statusrows = 0;
+}
+
+size_t unsent(void);
+
+// If status bar is enabled, redraw it at most every STATUSTIME mS, and only if it has changed. Otherwise remove it.
+void status(void)
+{
+    if (!statusbar) { nostatus(); return; }
+    long long now = mstime();
+    if (statusrows && now - statustime < STATUSTIME) return;
+
+    struct winsize ws;
+    if (ioctl(console, TIOCGWINSZ, &ws) || ws.ws_row < 2 || ws.ws_col < 2) return;
+
+    char s[sizeof(statusline) + 64], *p = s;
+    if (ws.ws_row != statusrows)
     {
+        // scroll one line if the cursor is on the bottom row, then restrict scrolling to rows above it
+        p += sprintf(p, "\eD\eM\e7\e[1;%dr\e8", ws.ws_row - 1);
+        statusrows = ws.ws_row;
+        *statusline = 0;                                    // force redraw
+    }
+
+    int elapsed = statustime ? now - statustime : 0;
+    char line[sizeof(statusline)];
+    int n = snprintf(line, sizeof(line), " %s | %s | rx %lu/s tx %lu/s | queued %d | timestamps %s",
+                     targetname, (target > 0) ? "connected" : "connecting",
+                     elapsed ? (rxbytes - rxlast) * 1000 / elapsed : 0,
+                     elapsed ? (txbytes - txlast) * 1000 / elapsed : 0,
+                     availq(qtarget), (view->timestamp > 1) ? "with date" : (view->timestamp ? "on" : "off"));
 #if FXCMD
-        if (running) return 0;                              // never hex FX output
+    if (running && n < sizeof(line)) n += snprintf(line + n, sizeof(line) - n, " | FX '%s'", running);
 #endif
-        if (!showhex) return 0;                             // done if hex not enabled
-        char s[5];
-        sprintf(s, "[%.2X]", c & 0xff);                     // show "[XX]"
-        putcon(s, 4);
-        dirty = 1;
-        return 1;                                           // note slurped
+    if (sendmap && n < sizeof(line)) n += snprintf(line + n, sizeof(line) - n, " | sending %d%%",
+                                (int)((sent - unsent()) * 100 / sendsize)); // file bytes that have left qsend
+    if (n >= ws.ws_col) n = ws.ws_col - 1;                  // truncate to fit
+    if (n >= sizeof(line)) n = sizeof(line) - 1;
+    line[n] = 0;
+    statustime = now;
+    rxlast = rxbytes;
+    txlast = txbytes;
+
+    if (strcmp(line, statusline))
+    {
+        // save cursor, draw in reverse video on the bottom row, restore cursor
+        p += sprintf(p, "\e7\e[%d;1H\e[7m%s\e[0m\e[K\e8", statusrows, line);
+        strcpy(statusline, line);
     }
+    if (p > s) put(console, s, p - s);
+}
+
+// Return mS until status() should be called, or -1 if status bar is not enabled
+int statusdue(void)
+{
+    if (!statusbar) return statusrows ? 0 : -1;
+    long long t = statustime + STATUSTIME - mstime();
+    return (t > 0) ? t : 0;
+}
+
+// Given count characters received in RAW mode, display them with timestamps, high-character encoding, hex
+// conversion, and mirror to teefile if enabled.
+void show(unsigned char *s, int count)
+{
+    if (conmode == RAW) showrender(view, s, count);        // done if not RAW
+}
 
+// Given one of the modes above, configure the console. Or given IDLE in RAW mode, show any partial output.
+void display(int c)
+{
     if (c == RECOOK)                                        // we're exiting, restore cooked if necessary
     {
-        if (!mode) return;
+        if (!conmode) return;
+        nostatus();                                         // remove status bar
         c = COOKED;
     }
 
-    if (!mode)                                              // perform one-time init
+    if (!conmode)                                           // perform one-time init
     {
-#if TRANSLIT
-        setlocale(LC_CTYPE, "");
-        iconv_t cd = iconv_open("//TRANSLIT", charset?:"CP437");
-        setlocale(LC_CTYPE, "C");
-        if (cd != (iconv_t)-1)
-        {
-            int n;
-            for (n = 128; n < 256; n++)
-            {
-                // Get the unicode string for each high char
-                char ch = n, *in = &ch, str[16], *out = str;
-                size_t nin = 1, nout = sizeof(str);
-                if (iconv(cd, &in, &nin, &out, &nout) < 0 || nin || nout == sizeof(str)) goto fail;
-                translit[n & 127] = strndup(str, sizeof(str) - nout);
-                if (!translit[n & 127]) die("%s\n", "Out of memory");
-            }
-            iconv_close(cd);
-            if (!charset) charset = "CP437"; // encoding is allowed
-        } else
-        {
-          fail:
-            // die if specifically requested, else leave charset==NULL
-            if (encode || charset) die("%s encoding not supported\n", charset?:"CP437");
-        }
-#endif
         tcgetattr(console, &cooked);                        // save current console config
         atexit(recook);                                     // restore cooked on unexpected exit
-        mode = COOKED;                                      // we are now in COOKED mode
+        conmode = COOKED;                                   // we are now in COOKED mode
+    }
+
+    if (c == IDLE)                                          // output is idle
+    {
+        if (conmode == RAW) idlerender(view);               // show partial output
+        return;
     }
 
     if (c < 0)                                              // new mode?
     {
-        if (c == mode || c < RAW) return;                   // ignore redundant or invalid (RECOOK)
-        if (dirty) putLF();                                 // make the cursor clean
-        mode = c;
-        switch(mode)
+        if (c == conmode || c < RAW) return;                // ignore redundant or invalid (RECOOK)
+        if (holding) put(console, "\r\e[K", 0), unhold(); // erase the edit line and show output held under it
+        flushrender(view);                                  // show pending output and make the cursor clean
+        conmode = c;
+        switch(conmode)
         {
             case RAW:
             {
@@ -329,181 +684,110 @@ void display(int c)
                 break;
             }
         }
-        return;
-    }
-
-    // Here, handle valid characters in RAW mode
-    if (mode != RAW || c > 255) return;                     // done if not
-
-    if (showhex > 1 && puthex(c)) return;                   // done if show all as hex
-
-    switch(c)
-    {
-        case LF:                                            // LF
-            if (!dirty) startline();                        // timestamp a blank line
-            putLF();
-            return;
-
-        case CR:                                            // CR
-            if (puthex(c)) return;                          // done if shown as hex
-            if (dirty) dirty = 2;                           // ignore if clean else defer until next
-            return;
-
-        case TAB:                                           // various printables
-        case FF:
-        case ESC:
-            if (puthex(c)) return;                          // done if shown as hex
-            // fall through
-        case BS:
-        case 32 ... 126:
-            if (!dirty) startline();                        // timestamp a blank line
-            else if (dirty > 1) putCR();                    // or CR if deferred
-            break;
-
-        case 128 ... 255:                                   // high characters
-#if FXCMD
-            if (running) break;                             // FX output displays verbatim
-#endif
-            if (puthex(c)) return;                          // done if shown as hex
-#if TRANSLIT
-            if (encode)                                     // use unicode if enabled
-            {
-                if (!dirty) startline();                    // timestamp a blank line
-                else if (dirty > 1) putCR();                // or CR if deferred
-                putcon(translit[c & 127], 0);               // put encoded string
-                dirty = 1;
-                return;
-            }
-#endif
-            break;                                          // show verbatim
-
-        default:                                            // all others
-            puthex(c);                                      // maybe show hex
-            return;
     }
-
-    // put character to the display
-    putcon(bytes(c), 1);
-    dirty = 1;
 }
 
-// sigwinch signal hander, technically should be #ifdef TELNET but complicates usage
+// sigwinch signal hander, also makes the renderer get the new console width
 bool sigwinch = false;
-void set_sigwinch(int sig) { sigwinch = true; }
+void set_sigwinch(int sig) { sigwinch = true; view->cols = 0; }
 
 // Connect or reconnect to specified targetname and set the 'target' file descriptor. Targetname can be in form
 // "host:port" or "/dev/ttyXXX".
 void doconnect()
 {
     int first = 1;
+    long long connecting = ustime();
 
     if (target)
     {
         // target is already open, report drop
+        trace(TLOST, 0, 0);
         printf("| Lost connection to %s\n", targetname);
-        close(target);
+        nc_disconnect(session);
+        target = 0;
         if (!reconnect) exit(1);
         printf("| Reconnecting to %s...\n", targetname);
     }
 
     while (1)
     {
-#if NETWORK
-        if (strchr(targetname, '/'))
-        {
-#endif
-            // "/dev/ttyXXX"
-            target = open(targetname, O_RDWR|O_NOCTTY|O_CLOEXEC);
-            if (!target) die("Target file opened as fd 0?\n");
-            if (target > 0)
-            {
-                // make sure it's raw
-                struct termios io;
-                tcgetattr(target, &io);
-                io.c_oflag = 0;
-                io.c_lflag = 0;
-                io.c_cc[VMIN] = 1;
-                io.c_cc[VTIME] = 0;
-                if (!native)
-                {
-                    // force 115200 N81
-                    io.c_cflag = CS8 | CLOCAL | CREAD;
-                    io.c_iflag = IGNPAR;
-                    cfsetspeed(&io, B115200);
-                }
-                if (tcsetattr(target, TCSANOW, &io)) die ("Can't configure %s: %s\n", targetname, strerror(errno));
-
-                if (dtr)
-                {
-                    ioctl(target, TIOCMBIC, (int[]){TIOCM_DTR}); // clear
-                    ioctl(target, TIOCMBIS, (int[]){TIOCM_DTR}); // then set
-                    ioctl(target, TIOCMBIS, (int[]){TIOCM_DTR}); // twice?
-                    usleep(50000); // 50 mS
-                    tcflush(target, TCIOFLUSH);
-                }
-
-                break;
-            }
-#if NETWORK
-        }
-        else if (strchr(targetname, ':'))
-        {
-            // "host:port"
-            char *host = strdup(targetname);
-            char *port = strchr(host, ':');
-            *port++ = 0;
-            struct addrinfo *ai, hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
-            int res = getaddrinfo(host, port, &hints, &ai);
-            if (res) die("Can't resolve %s: %s\n", targetname, gai_strerror(res));
-            target = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
-            if (!target) die("Target socket opened as fd 0?\n");
-            if (target < 0) die("Can't create socket: %s\n", strerror(errno));
-            if (connect(target, ai->ai_addr, ai->ai_addrlen))
-            {
-                if (errno != ECONNREFUSED && errno != ETIMEDOUT && errno != ENETUNREACH) reconnect = 0;
-                target = -1;
-            }
-            free(host);
-            freeaddrinfo(ai);
-            if (target > 0) break;
-        }
-        else die("%s must contain '/' or ':'\n", targetname);
-#endif
+        char error[256];
+        long long attempt = ustime();
+        int r = nc_connect(session, targetname, error, sizeof(error)); // also wipes qtarget if reconnecting
+        if (r > 0) break;
+        trace(TFAIL, 0, attempt);                       // each failed attempt, when retrying
+        if (r < 0) die("%s\n", error);
 
         // connect failed
-        if (first) printf("| Can't connect to %s: %s\n", targetname, strerror(errno));
+        if (first) printf("| %s\n", error);
         first = 0;
         if (!reconnect) exit(1); // die
 
         printf("| Retrying %s...\n", targetname);
+        fflush(stdout);
+        status();
         sleep(1);
     }
 
-    nonblocking(target);        // make sure target is non-blocking
-
+    target = nc_fd(session);
     if (flush) while (await(target, POLLIN, flush) > 0)
     {
-        char fb[1024];
-        if (read(target, fb, sizeof(fb)) < 0) break; // well, just break on read error
+        unsigned char fb[1024];
+        if (nc_read(session, fb, sizeof(fb)) < 0) break; // well, just break on read error
     }
     if (!reflush) flush = 0;
 
-    delq(&qtarget, -1);         // wipe qtarget if reconnecting
+    delq(&qsend, -1);
 
 #if TELNET
-    if (telnet)
-    {
-        if (tctx) free(tctx);   // maybe free old context
-        tctx = init_telnet(&qtarget, telnet == 1, getenv("TERM") ?: "dumb"); // target queue, binary, termtype
-        sigwinch = true;        // trigger resize
-    }
+    if (telnet) sigwinch = true; // trigger resize
 #endif
 
+    trace(TCONNECT, 0, connecting);
     printf("| Connected to %s, command key is ^\\.\n", targetname);
 }
 
 int command(void);
 
+// Prompt for a string and show scrollback lines that contain it, a page at a time
+void search(void)
+{
+    if (!scrollback.size)
+    {
+        printf("| Scrollback is not enabled.\n");
+        return;
+    }
+
+    char buf[256];
+    printf("| Search for: ");
+    if (!fgets(buf, sizeof(buf), stdin)) return;
+    buf[strcspn(buf, "\n")] = 0;
+    if (!*buf) return;
+
+    int page = 22;                              // lines per page
+    struct winsize ws;
+    if (ioctl(console, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 4) page = ws.ws_row - 2 - statusbar;
+
+    int found = 0;
+    for (int n = findring(&scrollback, 0, buf); n >= 0; n = findring(&scrollback, n + 1, buf))
+    {
+        if (found && !(found % page))
+        {
+            printf("| -- %d found, any key for more or q to stop --", found);
+            display(RAW);
+            int c = key(-1);
+            display(WARM);
+            printf("\r\e[K");                     // erase the prompt
+            if (c == 'q' || c == COMMAND) break;
+        }
+        char *line;
+        int length = getring(&scrollback, n, &line);
+        printf("| %.*s", length, line);
+        found++;
+    }
+    printf("| %d line%s found.\n", found, (found == 1) ? "" : "s");
+}
+
 #if FXCMD
 // Run specified FX command with stdin/stdout attached to target and stderr attached to console.
 // If cmd is NULL, prompt for it.
@@ -535,6 +819,8 @@ void run(char *cmd)
     if (*cmd)
     {
         running = cmd;                          // remember it globally
+        view->fx = true;                        // and show its output as such
+        long long fxstart = ustime();           // for trace
 
         // use pipes for command stdin and stdout
         int cmdin[2], cmdout[2];
@@ -578,14 +864,7 @@ void run(char *cmd)
         {
             unsigned char bf[1024];
             int n = read(rend(cmdout), bf, sizeof bf);
-            for (int i = 0; i < n; i++)
-            {
-#if TELNET
-                if (!telnet || tx_telnet(tctx, bf[i]))
-#endif
-                    putq(&qtarget, &bf[i], 1);
-                tx++;
-            }
+            if (n > 0) nc_escape(session, qtarget, bf, n), tx += n;
             return n;
         }
 
@@ -594,7 +873,7 @@ void run(char *cmd)
         {
             unsigned char bf[1024];
             int n = read(cmderr, bf, sizeof bf);
-            for (int i = 0; i < n; i++) display(bf[i]);
+            if (n > 0) show(bf, n);
             return n;
         }
 
@@ -602,15 +881,22 @@ void run(char *cmd)
 
         while (1)
         {
-            struct pollfd p[] = { { .fd = cmderr, .events = POLLIN },                                       // cmderr to console
-                                  { .fd = console, .events = POLLIN },                                      // console to cmderr
-                                  { .fd = availq(&qcmdin) < 4096 ? target : -1, .events = POLLIN },         // target to qcmdin, only if space
-                                  { .fd = availq(&qtarget) < 4096 ? rend(cmdout) : -1, .events = POLLIN },  // cmdout to qtarget, only if space
-                                  { .fd = availq(&qcmdin) ? wend(cmdin) : -1, .events = POLLOUT },          // qcmdin to cmdin, only if something in qcmdin
-                                  { .fd = availq(&qtarget) ? target : -1, .events = POLLOUT } };            // qtarget to target, only if something in qtarget
-
-            int r = poll(p, 6, -1);
-            if (r <= 0) break;
+            struct pollfd p[6 + MIRRORS + 1] = { { .fd = cmderr, .events = POLLIN },                                       // cmderr to console
+                                             { .fd = console, .events = POLLIN },                                      // console to cmderr
+                                             { .fd = availq(&qcmdin) < 4096 ? target : -1, .events = POLLIN },         // target to qcmdin, only if space
+                                             { .fd = availq(qtarget) < 4096 ? rend(cmdout) : -1, .events = POLLIN },  // cmdout to qtarget, only if space
+                                             { .fd = availq(&qcmdin) ? wend(cmdin) : -1, .events = POLLOUT },          // qcmdin to cmdin, only if something in qcmdin
+                                             { .fd = availq(qtarget) ? target : -1, .events = POLLOUT } };            // qtarget to target, only if something in qtarget
+            int np = 6 + pollmirrors(p + 6);                                                                           // mirrors with pending output
+            int pp = np;                                                                                               // and pipe
+            np += pollpipe(p + pp);
+
+            int r = poll(p, np, statusdue());
+            if (r < 0 && errno == EINTR) continue;  // SIGWINCH
+            if (r < 0) break;
+            status();                   // maybe update status bar
+            flushmirrors(p + 6);
+            flushpipe(p + pp);
 
             if (p[0].revents && cmderr2console() <= 0) break; // cmderr to console
 
@@ -635,13 +921,11 @@ void run(char *cmd)
             {
                 // target to qcmdin
                 unsigned char bf[1024];
-                int n = read(target, bf, sizeof bf);
-                if (n <= 0) break;
-                for (int i = 0; i < n; i++)
-#if TELNET
-                    if (!telnet || rx_telnet(tctx, bf[i]))
-#endif
-                        putq(&qcmdin, bf+i, 1);
+                int n = nc_read(session, bf, sizeof bf);
+                if (n < 0) break;
+                rxbytes += n;
+                trace(TREAD, n, 0);
+                putq(&qcmdin, bf, n);
             }
 
             if (p[3].revents && cmdout2qtarget() <= 0) break; // cmdout to qtarget
@@ -654,7 +938,13 @@ void run(char *cmd)
                 rx += n;
             }
 
-            if (p[5].revents && dequeue(&qtarget, target) <= 0) break; // qtarget to target
+            if (p[5].revents)
+            {
+                // qtarget to target
+                int n = dequeue(qtarget, target);
+                if (n <= 0) break;
+                txbytes += n;
+            }
         }
 
         // here, I/O error (possibly because of child exit) or abort.
@@ -701,20 +991,510 @@ void run(char *cmd)
         }
 
         running = NULL; // no longer running
+        view->fx = false;
+        trace(TFX, tx + rx, fxstart);
     }
     display(RAW); // back to raw mode
 }
 #endif
 
+// Send file state
+#define SENDQUEUE 4096          // maximum file bytes in qsend
+long long sendtime;             // mstime() of last progress report
+
+// Prompt for a file and start sending it to target, see sendmore()
+void sendfile(void)
+{
+    char name[256];
+    printf("| Send file: ");
+    if (!fgets(name, sizeof(name), stdin)) return;
+    name[strcspn(name, "\n")] = 0;
+    if (!*name) return;
+
+    int fd = open(name, O_RDONLY|O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st))
+        printf("| Can't open %s: %s\n", name, strerror(errno));
+    else if (!S_ISREG(st.st_mode) || !st.st_size)
+        printf("| %s is empty or not a file.\n", name);
+    else if ((sendmap = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        printf("| Can't map %s: %s\n", name, strerror(errno));
+        sendmap = NULL;
+    } else
+    {
+        madvise(sendmap, st.st_size, MADV_SEQUENTIAL);
+        sendsize = st.st_size;
+        sent = 0;
+        sendtime = mstime();
+        printf("| Sending %lu bytes, ^\\ to cancel.\n", (unsigned long)sendsize);
+    }
+    if (fd >= 0) close(fd);                             // the mapping stays
+}
+
+// Return the number of file bytes before sent that are still in qsend, allowing for telnet escapes
+size_t unsent(void)
+{
+    size_t n = 0;
+    for (int q = availq(&qsend); q > 0 && n < sent; n++)
+    {
+        q--;
+#if TELNET
+        unsigned char c = sendmap[sent - n - 1];
+        if (telnet && (c == 255 || (telnet == 2 && c == CR))) q--; // escaped
+#endif
+    }
+    return n;
+}
+
+// Stop sending file, discarding file data still queued if cancelled
+void endsend(bool cancel)
+{
+    if (cancel)
+    {
+        sent -= unsent();                               // not sent after all
+        delq(&qsend, -1);
+    }
+    munmap(sendmap, sendsize);
+    sendmap = NULL;
+    display(WARM);
+    printf("| %s %lu of %lu bytes.\n", cancel ? "Cancelled after" : "Sent", (unsigned long)sent, (unsigned long)sendsize);
+    display(RAW);
+}
+
+// Top up qsend from the file being sent, called from the main loop
+void sendmore(void)
+{
+    if (!sendmap) return;
+    size_t n = SENDQUEUE - availq(&qsend);
+    if (availq(&qsend) >= SENDQUEUE) n = 0;
+    if (n > sendsize - sent) n = sendsize - sent;
+    nc_escape(session, &qsend, sendmap + sent, n);
+    sent += n;
+
+    if (sent == sendsize && !availq(&qsend)) { endsend(false); return; }
+
+    long long now = mstime();
+    if (!statusbar && now - sendtime >= 1000)
+    {
+        // report progress once a second, unless the status bar shows it
+        char s[64];
+        sprintf(s, "| sent %lu of %lu bytes", (unsigned long)(sent - unsent()), (unsigned long)sendsize);
+        noterender(view, s);                            // on a line of its own
+        sendtime = now;
+    }
+}
+
+// Broadcast targets, see -y. Keys are translated and escaped once into a shared buffer, which each target sends from
+// at its own pace. Each target's output is kept in its own ring for viewing.
+#define FLEET 32                // maximum broadcast targets
+#define FLEETLINES 3            // lines of each target's output to view
+struct
+{
+    char *name;                 // target name
+    nc_session *s;              // target connection
+    int fd;                     // session's file descriptor, if > 0
+    int sent;                   // bytes of bcast sent
+    ring rx;                    // recent output
+} fleet[FLEET];
+int nfleet = 0;
+bool broadcast = false;         // true = send keys to the fleet too
+unsigned char bcast[65536];     // keys for the fleet
+int bcastlen = 0;               // bytes in bcast
+
+// Open broadcast targets
+void openfleet(void)
+{
+    for (int f = 0; f < nfleet; f++)
+    {
+        char error[256];
+        fleet[f].s = nc_new(&ncoptions);
+        int r = nc_connect(fleet[f].s, fleet[f].name, error, sizeof(error));
+        if (r < 0) die("%s\n", error);
+        if (!r) printf("| %s\n", error);
+        fleet[f].fd = (r > 0) ? nc_fd(fleet[f].s) : 0;
+        initring(&fleet[f].rx, 4096);
+    }
+}
+
+// Close a broadcast target
+void closefleet(int f, char *why)
+{
+    nc_disconnect(fleet[f].s);
+    fleet[f].fd = 0;
+    display(WARM);
+    printf("| %s broadcast target %s.\n", why, fleet[f].name);
+    display(RAW);
+}
+
+// Put translated keys to target and, if broadcasting, to the fleet
+void keyout(void *s, int count)
+{
+    putq(qtarget, s, count);
+    if (!broadcast || !nfleet) return;
+
+    while (bcastlen + count > sizeof(bcast))
+    {
+        // discard what every target has sent
+        int min = bcastlen, slow = -1;
+        for (int f = 0; f < nfleet; f++) if (fleet[f].fd > 0 && fleet[f].sent < min) min = fleet[f].sent, slow = f;
+        memmove(bcast, bcast + min, bcastlen - min);
+        bcastlen -= min;
+        for (int f = 0; f < nfleet; f++) fleet[f].sent = (fleet[f].sent > min) ? fleet[f].sent - min : 0;
+        if (bcastlen + count <= sizeof(bcast)) break;
+        if (slow < 0) return;                           // keys alone don't fit, drop them
+        // the slowest target is stuck, drop it rather than the keys for the rest
+        closefleet(slow, "Closed stuck");
+    }
+    memcpy(bcast + bcastlen, s, count);
+    bcastlen += count;
+}
+
+// Add a pollfd for each broadcast target. Return number added.
+int pollfleet(struct pollfd *p)
+{
+    for (int f = 0; f < nfleet; f++)
+        p[f] = (struct pollfd){ .fd = (fleet[f].fd > 0) ? fleet[f].fd : -1,
+                                .events = (nc_queued(fleet[f].s) || fleet[f].sent < bcastlen) ? POLLIN|POLLOUT : POLLIN };
+    return nfleet;
+}
+
+// Read from and write to broadcast targets, after poll()
+void servicefleet(struct pollfd *p)
+{
+    bool caught = true;                                 // true if every target has sent all of bcast
+    for (int f = 0; f < nfleet; f++)
+    {
+        if (fleet[f].fd <= 0 || p[f].fd != fleet[f].fd) continue;
+        if (p[f].revents & POLLOUT)
+        {
+            int n;
+            if (nc_queued(fleet[f].s)) n = dequeue(nc_queue(fleet[f].s), fleet[f].fd);
+            else if ((n = write(fleet[f].fd, bcast + fleet[f].sent, bcastlen - fleet[f].sent)) > 0) fleet[f].sent += n;
+            if (n < 0 && errno != EAGAIN) { closefleet(f, "Lost"); continue; }
+        }
+        if (p[f].revents & (POLLIN|POLLHUP|POLLERR))
+        {
+            unsigned char bf[1024];
+            int n = nc_read(fleet[f].s, bf, sizeof bf); // without telnet commands
+            if (n < 0) { closefleet(f, "Lost"); continue; }
+            int m = 0;
+            for (int i = 0; i < n; i++) if (bf[i] != CR) bf[m++] = bf[i]; // just keep the LFs
+            putring(&fleet[f].rx, bf, m);
+        }
+        if (fleet[f].sent < bcastlen) caught = false;
+    }
+    if (caught)
+    {
+        bcastlen = 0;
+        for (int f = 0; f < nfleet; f++) fleet[f].sent = 0;
+    }
+}
+
+// Show the last few lines from each broadcast target
+void viewfleet(void)
+{
+    if (!nfleet) { printf("| There are no broadcast targets.\n"); return; }
+    for (int f = 0; f < nfleet; f++)
+    {
+        printf("| %s%s:\n", fleet[f].name, (fleet[f].fd > 0) ? "" : " (disconnected)");
+        int lines = linesring(&fleet[f].rx);
+        for (int n = (lines > FLEETLINES) ? lines - FLEETLINES : 0; n < lines; n++)
+        {
+            char *line;
+            int length = getring(&fleet[f].rx, n, &line);
+            printf("|   %.*s", length, line);
+        }
+        if (fleet[f].rx.partial)
+        {
+            // and the partial line, i.e. a prompt
+            int start = (fleet[f].rx.head + fleet[f].rx.count - fleet[f].rx.partial) % fleet[f].rx.size;
+            printf("|   ");
+            for (int i = 0; i < fleet[f].rx.partial; i++) putchar(fleet[f].rx.data[(start + i) % fleet[f].rx.size]);
+            printf("\n");
+        }
+    }
+}
+
+// Control socket, see -C. Clients send frames of a command character, a 16-bit big-endian payload length and the
+// payload, and get replies in the same format:
+//   'S' data           - send data to target, no reply
+//   'E' mS pattern     - wait up to unsigned 32-bit big-endian mS for pattern in target output, reply 'E' with "1" if
+//                        found or "0" if timed out
+//   'Q'                - reply 'Q' with "name=value" status lines
+//   'O' key            - toggle option as if key was entered after ^\, reply 'O' with "1", or "0" if not supported
+//   'C' "1" or "0"     - start or stop capture of target output, which is sent as 'D' frames, reply 'C'
+#define CONTROLS 8              // maximum control clients
+#define FRAMEMAX 4096           // largest frame payload
+#define PATTERNMAX 256          // longest expect pattern
+#define CONTROLMAX (1 << 20)    // maximum queued replies, a client that doesn't keep up is dropped
+char *controlname = NULL;       // control socket path
+int control = 0;                // listening socket, if > 0
+struct
+{
+    int fd;                     // client socket, if > 0
+    unsigned char in[3 + FRAMEMAX]; // partial frame
+    int inlen;                  // bytes in in
+    queue out;                  // pending replies
+    bool capture;               // true = send target output
+    char pattern[PATTERNMAX];   // expect pattern
+    int patlen;                 // length of pattern, 0 if not expecting
+    char tail[PATTERNMAX];      // last patlen-1 bytes of target output, so pattern can span reads
+    int taillen;                // bytes in tail
+    long long deadline;         // mstime() when expect times out
+} controls[CONTROLS];
+
+// Remove control socket, registered with atexit()
+void unlinkcontrol(void) { unlink(controlname); }
+
+// Start listening on the control socket
+void listencontrol(void)
+{
+    struct sockaddr_un a = { .sun_family = AF_UNIX };
+    if (strlen(controlname) >= sizeof(a.sun_path)) die("Control socket name %s is too long\n", controlname);
+    strcpy(a.sun_path, controlname);
+    control = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0);
+    if (control <= 0) die("Can't create control socket: %s\n", strerror(errno));
+    unlink(controlname);                                // stale
+    if (bind(control, (struct sockaddr *)&a, sizeof(a)) || listen(control, 4)) die("Can't listen on %s: %s\n", controlname, strerror(errno));
+    atexit(unlinkcontrol);
+}
+
+// Close control client
+void closecontrol(int c)
+{
+    close(controls[c].fd);
+    freeq(&controls[c].out);
+    controls[c] = (typeof(controls[0])){0};
+}
+
+// Queue a reply frame to control client and try to send it
+void reply(int c, int type, const void *s, int size)
+{
+    if (availq(&controls[c].out) + 3 + size > CONTROLMAX) { closecontrol(c); return; } // not keeping up
+    putq(&controls[c].out, bytes(type, size >> 8, size & 255), 3);
+    putq(&controls[c].out, (void *)s, size);
+    if (dequeue(&controls[c].out, controls[c].fd) < 0 && errno != EAGAIN) closecontrol(c);
+}
+
+void barstat(void) { printf("| Status bar is %s.\n", statusbar ? "on" : "off"); }
 void bstat(void) { printf("| Backspace key sends %s.\n", bskey ? "DEL" : "BS"); }
 void estat(void) { printf("| Enter key sends %s.\n", enterkey ? "LF" : "CR"); }
-void hstat(void) { printf("| %s characters are shown as hex.\n", (showhex > 1) ? "All" : (showhex ? "Unprintable" : "No")); }
+void hstat(void) { printf("| %s characters are shown as %s.\n", (view->showhex > 1) ? "All" : (view->showhex ? "Unprintable" : "No"), (view->showhex > 2) ? "hexdump" : "hex"); }
 #ifdef TRANSLIT
-void istat(void) { printf("| %s encoding is %s.\n", charset, encode ? "on" : "off"); }
+void istat(void) { printf("| %s encoding is %s.\n", view->charset, view->encode ? "on" : "off"); }
 #endif
 void kstat(void) { printf("| Key lock is %s.\n", keylock ? "on" : "off"); }
 void rstat(void) { printf("| Automatic reconnect is %s.\n", reconnect ? "on" : "off"); }
-void sstat(void) { printf("| Timestamps are %s.\n", (timestamp > 1) ? "on, with date" : (timestamp ? "on" : "off") ); }
+void ustat(void) { printf("| UTF-8 validation is %s.\n", view->utf8 ? "on" : "off"); }
+void zstat(void) { printf("| Repeated line folding is %s.\n", view->folding ? (view->foldtee ? "on, including log file" : "on") : "off"); }
+void mstat(void) { printf("| Console is limited to %d characters per second.\n", view->ratelimit); }
+void editstat(void) { printf("| Local line editing is %s.\n", lineedit ? "on" : "off"); }
+void pstat(void)
+{
+    if (!pacing) printf("| Transmit pacing is off.\n");
+    else if (echosync) printf("| Transmit is paced by echo.\n");
+    else printf("| Transmit is paced, %d mS per character and %d mS per line.\n", chardelay, linedelay);
+}
+void wstat(void) { printf("| Line wrapping is %s.\n", view->wrap ? "on" : "off"); }
+void ystat(void)
+{
+    int n = 0;
+    for (int f = 0; f < nfleet; f++) n += fleet[f].fd > 0;
+    printf("| Broadcast to %d of %d target%s is %s.\n", n, nfleet, (nfleet == 1) ? "" : "s", broadcast ? "on" : "off");
+}
+void sstat(void) { printf("| Timestamps are %s.\n", (view->timestamp > 1) ? "on, with date" : (view->timestamp ? "on" : "off") ); }
+
+// Toggle option for the command menu or a control client, return the function that reports its new state, or NULL if
+// the option isn't supported or can't be toggled
+typedef void statfn(void);
+statfn *toggle(int c)
+{
+    switch(c)
+    {
+        case 'b': bskey = !bskey; return bstat;
+        case 'B': statusbar = !statusbar; sigwinch = true; return barstat;
+        case 'e': enterkey = !enterkey; return estat;
+        case 'E': lineedit = !lineedit; return editstat;
+        case 'h': view->showhex = !view->showhex; return hstat;
+        case 'H': view->showhex = (view->showhex != 2) * 2; return hstat;
+        case 'D': view->showhex = (view->showhex != 3) * 3; return hstat;
+#if TRANSLIT
+        case 'i':
+            if (!view->encode && !charsetrender(view)) return NULL;
+            view->encode = !view->encode;
+            return istat;
+#endif
+        case 'k': keylock = !keylock; return kstat;
+        case 'p':
+            pacing = !pacing;
+            if (!chardelay && !linedelay) echosync = true; // if not configured, pace by echo
+            return pstat;
+        case 'r': reconnect = !reconnect; return rstat;
+        case 's': view->timestamp = !view->timestamp; sigwinch = true; return sstat;
+        case 'S': view->timestamp = (view->timestamp != 2) * 2; sigwinch = true; return sstat;
+        case 'u': view->utf8 = !view->utf8; return ustat;
+        case 'w': view->wrap = !view->wrap; return wstat;
+        case 'y':
+            if (!nfleet) return NULL;
+            broadcast = !broadcast;
+            return ystat;
+        case 'z': view->folding = !view->folding; return zstat;
+        default: return NULL;
+    }
+}
+
+// Handle a complete frame from control client
+void frame(int c, int type, unsigned char *s, int size)
+{
+    switch(type)
+    {
+        case 'S':
+            nc_escape(session, qtarget, s, size);
+            break;
+
+        case 'E':
+            if (size < 5 || size - 4 > PATTERNMAX) { reply(c, 'E', "0", 1); break; }
+            controls[c].deadline = mstime() + ((uint32_t)s[0] << 24 | s[1] << 16 | s[2] << 8 | s[3]); // unsigned, up to ~49 days
+            controls[c].patlen = size - 4;
+            memcpy(controls[c].pattern, s + 4, size - 4);
+            controls[c].taillen = 0;                    // only new output
+            break;
+
+        case 'Q':
+        {
+            char q[512];
+            int n = snprintf(q, sizeof q, "target=%s\nconnected=%d\nrx=%lu\ntx=%lu\nqueued=%d\n"
+                                          "hex=%d\ntimestamp=%d\nutf8=%d\nfolding=%d\nwrap=%d\npacing=%d\nkeylock=%d\nreconnect=%d\n",
+                             targetname, target > 0, rxbytes, txbytes, availq(qtarget),
+                             view->showhex, view->timestamp, view->utf8, view->folding, view->wrap, pacing, keylock, reconnect);
+            reply(c, 'Q', q, (n < sizeof q) ? n : sizeof q - 1);
+            break;
+        }
+
+        case 'O':
+            reply(c, 'O', (size == 1 && toggle(*s)) ? "1" : "0", 1);
+            break;
+
+        case 'C':
+            controls[c].capture = size && *s == '1';
+            reply(c, 'C', controls[c].capture ? "1" : "0", 1);
+            break;
+
+        default:
+            closecontrol(c);                            // protocol error
+            break;
+    }
+}
+
+// Check target output against control clients' expect patterns, and send it to those that are capturing
+void controlrx(unsigned char *s, int count)
+{
+    for (int c = 0; c < CONTROLS; c++)
+    {
+        if (controls[c].fd <= 0) continue;
+        if (controls[c].capture)
+            for (int o = 0, n; o < count && controls[c].fd > 0; o += n)
+            {
+                n = (count - o > FRAMEMAX) ? FRAMEMAX : count - o;
+                reply(c, 'D', s + o, n);
+            }
+        if (controls[c].fd <= 0 || !controls[c].patlen) continue;
+
+        // search the tail plus this output
+        char w[PATTERNMAX + 1024];
+        for (int o = 0, n; o < count; o += n)
+        {
+            n = (count - o > 1024) ? 1024 : count - o;
+            memcpy(w, controls[c].tail, controls[c].taillen);
+            memcpy(w + controls[c].taillen, s + o, n);
+            int len = controls[c].taillen + n, keep = controls[c].patlen - 1;
+            if (memmem(w, len, controls[c].pattern, controls[c].patlen))
+            {
+                controls[c].patlen = 0;
+                reply(c, 'E', "1", 1);
+                break;
+            }
+            if (keep > len) keep = len;
+            memcpy(controls[c].tail, w + len - keep, keep);
+            controls[c].taillen = keep;
+        }
+    }
+}
+
+// Return mS until the next expect times out, or -1 if none
+int controltime(void)
+{
+    long long t = -1, now = mstime();
+    for (int c = 0; c < CONTROLS; c++)
+        if (controls[c].fd > 0 && controls[c].patlen && (t < 0 || controls[c].deadline - now < t))
+            t = (controls[c].deadline > now) ? controls[c].deadline - now : 0;
+    return t;
+}
+
+// Add pollfds for the control socket and each client. Return number added.
+int pollcontrol(struct pollfd *p)
+{
+    if (!control) return 0;
+    p[0] = (struct pollfd){ .fd = control, .events = POLLIN };
+    for (int c = 0; c < CONTROLS; c++)
+        p[c + 1] = (struct pollfd){ .fd = (controls[c].fd > 0) ? controls[c].fd : -1,
+                                    .events = availq(&controls[c].out) ? POLLIN|POLLOUT : POLLIN };
+    return CONTROLS + 1;
+}
+
+// Accept control clients, read their frames and send replies, after poll(). Also time out expects.
+void servicecontrol(struct pollfd *p)
+{
+    if (!control) return;
+    if (p[0].revents)
+    {
+        int fd = accept4(control, NULL, NULL, SOCK_CLOEXEC|SOCK_NONBLOCK);
+        int c = 0;
+        while (c < CONTROLS && controls[c].fd > 0) c++;
+        if (fd > 0 && c < CONTROLS) controls[c].fd = fd;
+        else if (fd >= 0) close(fd);                    // too many
+    }
+
+    long long now = mstime();
+    for (int c = 0; c < CONTROLS; c++)
+    {
+        if (controls[c].fd <= 0) continue;
+        struct pollfd *q = p + c + 1;
+        if (q->fd == controls[c].fd && (q->revents & POLLOUT) && dequeue(&controls[c].out, controls[c].fd) < 0 && errno != EAGAIN)
+        {
+            closecontrol(c);
+            continue;
+        }
+        if (q->fd == controls[c].fd && (q->revents & (POLLIN|POLLHUP|POLLERR)))
+        {
+            int n = read(controls[c].fd, controls[c].in + controls[c].inlen, sizeof(controls[c].in) - controls[c].inlen);
+            if (n <= 0 && (!n || errno != EAGAIN))
+            {
+                closecontrol(c);
+                continue;
+            }
+            if (n > 0) controls[c].inlen += n;
+            // handle complete frames
+            unsigned char *f = controls[c].in;
+            while (controls[c].fd > 0 && controls[c].inlen >= 3)
+            {
+                int size = (f[1] << 8) | f[2];
+                if (size > FRAMEMAX) { closecontrol(c); break; }
+                if (controls[c].inlen < 3 + size) break;
+                frame(c, f[0], f + 3, size);
+                if (controls[c].fd <= 0) break;
+                controls[c].inlen -= 3 + size;
+                memmove(f, f + 3 + size, controls[c].inlen);
+            }
+        }
+        if (controls[c].fd > 0 && controls[c].patlen && now >= controls[c].deadline)
+        {
+            controls[c].patlen = 0;
+            reply(c, 'E', "0", 1);                      // timed out
+        }
+    }
+}
 
 // Command key handler. Return 1 if caller should send the COMMAND key to
 // target, -1 if caller should kill running FX command, or 0.
@@ -730,18 +1510,13 @@ int command(void)
     printf("%c\n", (c >= ' ' && c <= '~') ? c : 0);
     switch(c)
     {
-        case 'b': bskey = !bskey; bstat(); break;
-        case 'e': enterkey = !enterkey; estat(); break;
-        case 'h': showhex = !showhex; hstat(); break;
-        case 'H': showhex = (showhex != 2) * 2; hstat(); break;
-#if TRANSLIT
-        case 'i': if (charset) encode = !encode, istat(); break;
+        case '/': search(); break;
+#if SESSION
+        case 'd': if (sessionname) detach_session(); break;
 #endif
-        case 'k': keylock = !keylock; kstat(); break;
+        case 'f': sendfile(); break;
         case 'q': display(COOKED); exit(0);
-        case 'r': reconnect = !reconnect; rstat(); break;
-        case 's': timestamp = !timestamp; sigwinch = true; sstat(); break;
-        case 'S': timestamp = (timestamp != 2) * 2; sigwinch = true; sstat(); break;
+        case 'v': viewfleet(); break;
 #if FXCMD
         case 'x': if (running) ret = -1; else run(NULL); break;
 #endif
@@ -754,32 +1529,67 @@ int command(void)
 #if TELNET
             if (telnet) printf("| Telnet is enabled in %s mode.\n", (telnet == 1) ? "binary" : "ASCII");
 #endif
+#if SESSION
+            if (sessionname) printf("| Session socket is %s.\n", sessionname);
+#endif
+            if (control)
+            {
+                int n = 0;
+                for (int c = 0; c < CONTROLS; c++) n += controls[c].fd > 0;
+                printf("| Control socket is %s, %d client%s connected.\n", controlname, n, (n == 1) ? "" : "s");
+            }
             if (teefd) printf("| Console output is logged to %s.\n", teename);
+            if (traces) printf("| Tracing to %s, %lu events recorded.\n", tracename, ntraces);
+            for (int m = 0; m < nmirrors; m++)
+                printf("| Console is mirrored to %s%s, %lu bytes dropped.\n", mirrors[m].name, (mirrors[m].fd > 0) ? "" : " (not open)", mirrors[m].lost);
+            if (pipecmd)
+                printf("| %s output is piped to '%s'%s, %lu bytes dropped.\n", piperaw ? "Target" : "Console", pipecmd, (pipefd > 0) ? "" : " (exited)", pipelost);
+            if (scrollback.size) printf("| Last %d kB of console output can be searched, %d lines are kept.\n", scrollsize, linesring(&scrollback));
             bstat();
+            if (statusbar) barstat();
             estat();
-            if (showhex) hstat();
+            if (lineedit) editstat();
+            if (view->showhex) hstat();
 #if TRANSLIT
-            if (charset) istat();
+            istat();
 #endif
             if (keylock) kstat();
+            if (view->ratelimit) mstat();
+            if (pacing) pstat();
             if (reconnect) rstat();
-            if (timestamp) sstat();
+            if (view->timestamp) sstat();
+            if (view->utf8) ustat();
+            if (view->wrap) wstat();
+            if (nfleet) ystat();
+            if (view->folding) zstat();
             printf("|\n"
                    "| The following keys are supported after ^\\:\n"
+                   "|    / - search console output.\n"
                    "|    b - toggle backspace key between BS and DEL.\n"
-                   "|    c - toggle enter key between CR and LF.\n"
+                   "|    B - toggle status bar on or off.\n"
+                   "|    c - toggle enter key between CR and LF.\n");
+#if SESSION
+            if (sessionname) printf("|    d - detach from session.\n");
+#endif
+            printf("|    E - toggle local line editing on or off.\n"
+                   "|    f - send a file to target.\n"
                    "|    h - toggle unprintable characters as hex on or off.\n"
-                   "|    H - toggle all characters as hex on or off.\n");
+                   "|    H - toggle all characters as hex on or off.\n"
+                   "|    D - toggle all characters as hexdump on or off.\n");
 #if TRANSLIT
-            if (charset) {
-            printf("|    i - toggle %s encoding on or off.\n", charset);
-            }
+            printf("|    i - toggle %s encoding on or off.\n", view->charset);
 #endif
             printf("|    k - toggle key lock on or off.\n"
+                   "|    p - toggle transmit pacing on or off.\n"
                    "|    q - close connection and quit.\n"
                    "|    r - toggle automatic reconnect.\n"
                    "|    s - toggle timestamps on or off.\n"
-                   "|    S - toggle long timestamps on or off.\n");
+                   "|    S - toggle long timestamps on or off.\n"
+                   "|    u - toggle UTF-8 validation on or off.\n"
+                   "|    v - view recent output from broadcast targets.\n"
+                   "|    w - toggle line wrapping on or off.\n"
+                   "|    y - toggle broadcast to other targets on or off.\n"
+                   "|    z - toggle repeated line folding on or off.\n");
 #ifdef FXCMD
             printf("|    x - %s.\n", running ? "kill running FX command" : "run FX command");
             printf("|    \\ - send ^\\ to %s.\n", running ? "FX command" : "target");
@@ -794,32 +1604,249 @@ int command(void)
             printf("\n");
             display(RAW);
             break;
+
+        default:
+        {
+            // an option toggle, shared with control clients
+            statfn *report = toggle(c);
+            if (report) report();
+#if TRANSLIT
+            else if (c == 'i') printf("| %s encoding is not supported.\n", view->charset);
+#endif
+            else if (c == 'y') printf("| There are no broadcast targets.\n");
+            break;
+        }
     }
     display(RAW);
+    if (editlen >= 0) holding = true, drawedit();       // back to editing, display(WARM) showed what was held
     return ret;
 }
 
+// Paced transmit state
+#define ECHOTIME 250            // mS to wait for an echo before sending the next character anyway
+long long pacenext = 0;         // mstime() when the next paced character can be sent
+bool echowait = false;          // true if waiting for an echo
+
+// Return mS until the next paced character can be sent to target, 0 if now, or -1 if not pacing or nothing to send
+int pacetime(void)
+{
+    if (!pacing || !(availq(qtarget) || availq(&qsend))) return -1;
+    long long t = pacenext - mstime();
+    return (t > 0) ? t : 0;
+}
+
+// Send one character from qtarget, or else qsend, and start the pause. Return the number of bytes written or < 0 if
+// error.
+int sendpaced(void)
+{
+    unsigned char *c;
+    queue *q = availq(qtarget) ? qtarget : &qsend;
+    if (!getq(q, (void **)&c)) return 0;
+    int n = write(target, c, 1);
+    if (n <= 0) return n;
+    echowait = echosync && *c;                          // NUL (as in telnet CR+NUL) isn't echoed
+    pacenext = mstime() + (echowait ? ECHOTIME : (*c == CR || *c == LF) ? linedelay : chardelay);
+    delq(q, 1);
+    return n;
+}
+
+// Send key to target
+void sendkey(int c)
+{
+    switch(c)
+    {
+        case BS:                    // backspace sends BS or DEL
+        case DEL:
+            keyout(bytes(bskey ? DEL : BS), 1);
+            break;
+
+        case LF:                    // enter sends CR or LF
+            if (enterkey)
+                keyout(bytes(LF), 1);
+            else
+#if TELNET
+            if (telnet == 2)
+                keyout(bytes(CR, NUL), 2); // ASCII telnet expands CR
+            else
+#endif
+                keyout(bytes(CR), 1);
+            break;
+
+        case 0:                     // drop 0
+        case CR:                    // drop CR
+        case 128 ... 255:           // and high characters
+            break;
+
+        default:                    // send all others
+            keyout(bytes(c), 1);
+            break;
+    }
+}
+
+// Erase the edit line and show console output that was held
+void endedit(void)
+{
+    if (holding) put(console, "\r\e[K", 0), unhold();
+    editlen = -1;
+}
+
+// Start holding console output, with the cursor on a row of its own for the edit line. This doesn't touch the tee.
+void hold(void)
+{
+    if (view->dirty) put(console, bytes(CR, LF), 2);
+    holding = true;
+}
+
+// Show held console output and redraw the edit line under it, when too much is held
+void reedit(void)
+{
+    put(console, "\r\e[K", 0);
+    unhold();
+    hold();
+    drawedit();
+}
+
+// Edit a line locally one key at a time, starting with key c, and send it to the target all at once when enter is
+// pressed. BS/DEL erases a character, ^U erases the line, ^W erases a word, up and down arrows select from history, ESC
+// or ^C abandons the line. Other keys on an empty line are sent as usual. Target output still goes to the tee file and
+// scrollback, but the console view of it is held until done.
+void editline(int c)
+{
+    if (editlen < 0)
+    {
+        editlen = 0;
+        edith = -1;
+    }
+    if (!holding) hold();
+    switch(c)
+    {
+        case 32 ... 126:
+            if (editlen < EDITMAX) editbuf[editlen++] = c;
+            break;
+
+        case BS:
+        case DEL:
+            if (!editlen) goto send;                    // nothing to erase, send it
+            editlen--;
+            break;
+
+        case 21:                                        // ^U
+            editlen = 0;
+            break;
+
+        case 23:                                        // ^W
+            while (editlen && editbuf[editlen-1] == ' ') editlen--;
+            while (editlen && editbuf[editlen-1] != ' ') editlen--;
+            break;
+
+        case ESC:
+            c = key(50);                                // cursor keys send ESC [ x or ESC O x, all at once
+            if (c == '[' || c == 'O')
+            {
+                int k = key(50);
+                if (k == 'A' && edith < histlen - 1) edith++; // up
+                else if (k == 'B' && edith >= 0) edith--; // down
+                else if (k == 'A' || k == 'B') break;
+                else if (editlen) break;                // ignore other keys
+                else
+                {
+                    keyout(bytes(ESC, c, k), k ? 3 : 2); // not for us, send it
+                    goto done;
+                }
+                if (edith < 0) editlen = 0;
+                else memcpy(editbuf, history[edith], editlen = strlen(history[edith]));
+                break;
+            }
+            if (!editlen) keyout(bytes(ESC, c), c ? 2 : 1); // empty line, send ESC or alt-key
+            goto done;                                  // else abandon the line
+
+        case 3:                                         // ^C
+            if (editlen) goto done;                     // abandon the line
+            goto send;
+
+        case LF:                                        // enter sends the line
+            if (editlen && (!histlen || strncmp(history[0], editbuf, editlen) || history[0][editlen]))
+            {
+                // remember it
+                if (histlen == HISTORY) free(history[--histlen]);
+                memmove(history + 1, history, histlen++ * sizeof(char *));
+                history[0] = strndup(editbuf, editlen);
+                if (!history[0]) die("%s\n", "Out of memory");
+            }
+            if (enterkey) editbuf[editlen++] = LF;
+#if TELNET
+            else if (telnet == 2) editbuf[editlen++] = CR, editbuf[editlen++] = NUL; // ASCII telnet expands CR
+#endif
+            else editbuf[editlen++] = CR;
+            keyout(editbuf, editlen);
+            goto done;
+
+        default:
+            if (!editlen) goto send;
+            break;
+    }
+    drawedit();
+    return;
+
+    send:
+    endedit();
+    sendkey(c);
+    return;
+
+    done:
+    endedit();
+}
+
 int main(int argc, char *argv[])
 {
-    while (1) switch (getopt(argc,argv,":bdef:hHiI:kl:L:nrsStTx:X:"))
+    render options = { .charset = "CP437" };    // display options, until the session's renderer takes them over
+    view = &options;
+    while (1) switch (getopt(argc,argv,":a:A:bBC:dDeEf:G:hHiI:kl:L:m:M:no:O:p:P:rsStTuwWx:X:y:zZ"))
     {
+#if SESSION
+        case 'a': attachname = optarg; break;
+        case 'A': sessionname = optarg; break;
+#endif
         case 'b': bskey = true; break;
+        case 'B': statusbar = true; break;
+        case 'C': controlname = optarg; break;
         case 'd': dtr = true; break;
+        case 'D': view->showhex = 3; break;
         case 'e': enterkey = true; break;
+        case 'E': lineedit = true; break;
         case 'f': teename = optarg; break;
-        case 'h': showhex = 1; break;
-        case 'H': showhex = 2; break;
+        case 'G': tracename = optarg; break;
+        case 'h': view->showhex = 1; break;
+        case 'H': view->showhex = 2; break;
 #if TRANSLIT
-        case 'i': encode = true; break;
-        case 'I': charset = optarg; break;
+        case 'i': view->encode = true; break;
+        case 'I': view->charset = optarg; break;
 #endif
         case 'k': keylock = true; break;
         case 'l': flush = atoi(optarg); reflush = false; break;
         case 'L': flush = atoi(optarg); reflush = true; break;
+        case 'm': view->ratelimit = atoi(optarg); break;
+        case 'M': scrollsize = atoi(optarg); break;
         case 'n': native = true; break;
+        case 'o': addmirror(optarg); break;
+        case 'O': pipecmd = optarg; piperaw = false; break;
+        case 'p':
+            pacing = true;
+            echosync = !strcmp(optarg, "echo");
+            if (!echosync && sscanf(optarg, "%d,%d", &chardelay, &linedelay) < 1) die("Invalid pacing %s\n", optarg);
+            break;
+        case 'P': pipecmd = optarg; piperaw = true; break;
         case 'r': reconnect = true; break;
-        case 's': timestamp = 1; break;
-        case 'S': timestamp = 2; break;
+        case 's': view->timestamp = 1; break;
+        case 'S': view->timestamp = 2; break;
+        case 'u': view->utf8 = true; break;
+        case 'w': view->wrap = true; break;
+        case 'W': pipewait = true; break;
+        case 'y':
+            if (nfleet >= FLEET) die("Too many broadcast targets\n");
+            fleet[nfleet++].name = optarg;
+            broadcast = true;
+            break;
 #if TELNET
         case 't': telnet = 1; break; // binary
         case 'T': telnet = 2; break; // ascii
@@ -828,18 +1855,48 @@ int main(int argc, char *argv[])
         case 'x': start = optarg; restart = false; break;
         case 'X': start = optarg; restart = true; break;
 #endif
+        case 'z': view->folding = true; break;
+        case 'Z': view->folding = view->foldtee = true; break;
         case -1: goto optx;                 // no more options
         default: die("%s\n", usage);        // invalid options
     } optx:
+#if SESSION
+    if (attachname)
+    {
+        // just a client
+        if (attach_session(attachname)) die("Can't attach to session %s: %s\n", attachname, strerror(errno));
+        exit(0);
+    }
+#endif
     if (optind >= argc) die("%s\n", usage);
     targetname = argv[optind];
+    if (scrollsize > 0) initring(&scrollback, scrollsize * 1024);
+#if TRANSLIT
+    if (view->encode && !charsetrender(view)) die("%s encoding not supported\n", view->charset);
+#endif
+#if SESSION
+    if (sessionname) start_session(sessionname, (scrollsize > 0) ? scrollsize * 1024 : 65536); // returns in the session
+#endif
+    ncoptions = (nc_options){ .native = native, .dtr = dtr };
+#if TELNET
+    ncoptions.telnet = telnet;
+#endif
+    session = nc_new(&ncoptions);
+    qtarget = nc_queue(session);
+    view = nc_render(session);
+    *view = options;
+    view->conout = rendercon;
+    view->teeout = (teename || scrollsize > 0) ? rendertee : NULL;
+    view->columns = rendercols;
+    if (controlname) listencontrol();
+    openfleet();
+    startpipe();
+    starttrace();
 
     signal(SIGPIPE, SIG_IGN);               // ignore broken pipe
     signal(SIGQUIT, SIG_IGN);               // and ^],
     signal(SIGTSTP, SIG_IGN);               // and ^Z
-#ifdef TELNET
-    if (telnet) signal(SIGWINCH, set_sigwinch);
-#endif
+    sigaction(SIGWINCH, &(struct sigaction){ .sa_handler = set_sigwinch, .sa_flags = SA_RESTART }, NULL); // console resize
 
     while(1)
     {
@@ -873,73 +1930,80 @@ int main(int argc, char *argv[])
                 if (ioctl(console, TIOCGWINSZ, &ws) == 0)
                 {
                     int cols = ws.ws_col;
-                    switch(timestamp)
+                    switch(view->timestamp)
                     {
                         case 1: cols -= 15; break;  // "[HH:MM:SS.mmm] "
                         case 2: cols -= 26; break;  // "[YYYY:MM:DD HH:MM:SS.mmm] "
                     }
-                    resize_telnet(tctx, cols, ws.ws_row);
+                    resize_telnet(nc_telnet(session), cols, ws.ws_row - statusbar); // status bar takes a row
                 }
             }
 #endif
 
-            struct pollfd p[] = { { .fd = console, .events = POLLIN },
-                                  { .fd = target, .events = POLLIN },
-                                  { .fd = availq(&qtarget) ? target : -1, .events = POLLOUT } };
-
-            poll(p, 3, -1);
+            sendmore();                         // maybe queue more of the file being sent
+            int pace = pacetime();              // > 0 if paced character isn't due yet
+            struct pollfd p[3 + MIRRORS + 1 + 1 + CONTROLS + FLEET] = { { .fd = console, .events = POLLIN },
+                                             { .fd = pipefull() ? -1 : target, .events = POLLIN },
+                                             { .fd = ((availq(qtarget) || availq(&qsend)) && pace <= 0) ? target : -1, .events = POLLOUT } };
+            int np = 3 + pollmirrors(p + 3);     // mirrors with pending output
+            int pp = np;                        // pipe with pending output
+            np += pollpipe(p + pp);
+            int pc = np;                        // control socket and clients
+            np += pollcontrol(p + pc);
+            int pf = np;                        // broadcast targets
+            np += pollfleet(p + pf);
+
+            int timeout = duerender(view), due = statusdue();
+            if (due >= 0 && (timeout < 0 || due < timeout)) timeout = due;
+            if (pace > 0 && (timeout < 0 || pace < timeout)) timeout = pace;
+            int expect = controltime();
+            if (expect >= 0 && (timeout < 0 || expect < timeout)) timeout = expect;
+            if (!poll(p, np, timeout)) display(IDLE); // maybe show partial output on timeout
+            status();                           // maybe update status bar
+            if (tracedump) writetrace();        // SIGUSR2
+            flushmirrors(p + 3);
+            flushpipe(p + pp);
+            servicecontrol(p + pc);
+            servicefleet(p + pf);
 
             if (p[0].revents)
             {
                 // console to target
                 int c = key(0);
-                if (c == COMMAND)
+                trace(TKEY, 1, 0);
+                if (c == COMMAND && sendmap) endsend(true); // cancel send file
+                else if (c == COMMAND)
                 {
-                    if (command() == 1) putq(&qtarget, bytes(COMMAND), 1); // maybe forward
-                }
-                else if (!keylock) switch(c)
-                {
-                    case BS:                    // backspace sends BS or DEL
-                    case DEL:
-                        putq(&qtarget, bytes(bskey ? DEL : BS), 1);
-                        break;
-
-                    case LF:                    // enter sends CR or LF
-                        if (enterkey)
-                            putq(&qtarget, bytes(LF), 1);
-                        else
-#if TELNET
-                        if (!telnet || tx_telnet(tctx, CR))
-#endif
-                            putq(&qtarget, bytes(CR), 1);
-                        break;
-
-                    case 0:                     // drop 0
-                    case CR:                    // drop CR
-                    case 128 ... 255:           // and high characters
-                        break;
-
-                    default:                    // send all others
-                        putq(&qtarget, bytes(c), 1);
-                        break;
+                    if (command() == 1) keyout(bytes(COMMAND), 1); // maybe forward
                 }
+                else if (keylock);
+                else if (editlen >= 0 || (lineedit && ((c >= 32 && c <= 126) || c == ESC))) editline(c); // edit locally
+                else sendkey(c);
             }
 
             if (p[1].revents)
             {
                 // target to console
                 unsigned char bf[1024];
-                int n = read(target, bf, sizeof bf);
-                if (n <= 0) break;              // assume dropped if errorr
-                for (int i = 0; i < n; i++)     // for each char
-#if TELNET
-                    if (!telnet || rx_telnet(tctx, bf[i]))
-#endif
-                        display(bf[i]);         // display it
+                int n = nc_read(session, bf, sizeof bf); // without telnet commands
+                if (n < 0) break;               // assume dropped if error
+                rxbytes += n;
+                trace(TREAD, n, 0);
+                show(bf, n);                    // display it, the console view is held while editing
+                if (holding && availq(&editheld) > HOLDMAX) reedit(); // too much, show it
+                if (piperaw) pipeout(bf, n);    // maybe pipe it
+                controlrx(bf, n);               // and check it for control clients
+                if (echowait) echowait = false, pacenext = mstime(); // echoed, send the next
             }
 
             // send qtarget if target writable
-            if (p[2].revents && dequeue(&qtarget, target) <= 0) break;
+            if (p[2].revents)
+            {
+                int n = pacing ? sendpaced() : dequeue(availq(qtarget) ? qtarget : &qsend, target); // keys first
+                if (n <= 0) break;
+                txbytes += n;
+                trace(TSEND, n, 0);
+            }
         }
     }
 }
@@ -0,0 +1,74 @@
+// libnanocom, the nanocom connection engine and console renderer for use in other programs. nanocom itself is built
+// on it, see nanocom.c for a complete example.
+
+#include <stdbool.h>
+#include "queue.h"
+#include "ring.h"
+#include "target.h"
+#include "render.h"
+#if TELNET
+#include "telnet.h"
+#endif
+
+typedef struct nc_session nc_session;
+
+// Session options, zero is the default for each
+typedef struct
+{
+    bool native;                // true = don't force serial 115200 N-8-1
+    bool dtr;                   // true = toggle serial DTR on connect
+    int telnet;                 // 0 = disabled, 1 = binary, 2 = ASCII (if built with TELNET)
+    int scrollback;             // bytes of target output to keep in the session's ring, 0 = none
+    void (*receive)(void *arg, unsigned char *data, int count); // called by nc_poll() with target output, if not NULL
+    void *arg;                  // passed to receive()
+} nc_options;
+
+// Return a new unconnected session.
+nc_session *nc_new(nc_options *options);
+
+// Connect, or reconnect, session to target (see open_target()), wiping anything still queued for the old connection.
+// Return 1 if connected, 0 if not but may succeed on retry, or -1 if it can't succeed, with an explanation written to
+// error.
+int nc_connect(nc_session *s, char *target, char *error, int size);
+
+// Return a new session connected to target, or NULL with an explanation written to error.
+nc_session *nc_open(char *target, nc_options *options, char *error, int size);
+
+// Queue count bytes to be sent to target, with telnet escapes if enabled.
+void nc_send(nc_session *s, void *data, int count);
+
+// Add count bytes to queue q, with telnet escapes if enabled, for callers that send from their own queues.
+void nc_escape(nc_session *s, queue *q, void *data, int count);
+
+// Read up to size bytes from target into data and remove telnet commands. Return the number of bytes left, which may
+// be 0, or -1 if the connection has closed. Target output is also added to the session's ring.
+int nc_read(nc_session *s, unsigned char *data, int size);
+
+// Wait up to timeout mS (-1 forever) for the target, send queued bytes and pass received bytes to receive(), and to
+// the session's renderer if its conout() is set. Return the number of bytes received, or -1 if the connection has
+// closed.
+int nc_poll(nc_session *s, int timeout);
+
+// Return the target file descriptor, for callers that poll it themselves, or -1 if not connected.
+int nc_fd(nc_session *s);
+
+// Return the queue of bytes waiting to be sent to target. Bytes added directly aren't telnet escaped.
+queue *nc_queue(nc_session *s);
+
+// Return the session's telnet context for resize_telnet() etc, or NULL if none.
+void *nc_telnet(nc_session *s);
+
+// Return the number of bytes waiting to be sent to target.
+#define nc_queued(s) availq(nc_queue(s))
+
+// Return the session's scrollback ring, or NULL if none.
+ring *nc_ring(nc_session *s);
+
+// Return the session's console renderer, see render.h. Its options and outputs are set by the caller.
+render *nc_render(nc_session *s);
+
+// Disconnect, the session can be reconnected.
+void nc_disconnect(nc_session *s);
+
+// Disconnect and free the session.
+void nc_close(nc_session *s);
@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "queue.h"
 
@@ -10,10 +11,14 @@ void putq(queue *q, void *data, int count)
 {
     if (q->size <= q->count + count)
     {
+        int size = q->size;
         if (!q->size) q->size = 1024;               // first time init
         while (q->size <= q->count + count) q->size *= 2;
         q->data = realloc(q->data, q->size);        // just malloc() if q->data == NULL
         if (!q->data) abort();                      // abort on OOM
+        if (q->head + q->count > size)
+            // data wrapped around the old end, move the wrapped part after it (there's room, size at least doubled)
+            memcpy(q->data + size, q->data, q->head + q->count - size);
     }
 
     for (int i = 0; i < count; i++, q->count++)
@@ -74,4 +79,5 @@ void freeq(queue *q)
     delq(q, -1);
     free(q->data);  // OK if NULL
     q->data = NULL;
+    q->size = 0;    // so putq() allocates again
 }
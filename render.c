@@ -0,0 +1,874 @@
+// Console renderer
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#if TRANSLIT
+#include <iconv.h>
+#include <locale.h>
+#include <strings.h>
+#endif
+#include "render.h"
+#if TRANSLIT
+#include "translit.h"
+#endif
+
+// ASCII controls of interest
+#define BS 8
+#define TAB 9
+#define LF 10
+#define FF 12
+#define CR 13
+#define ESC 27
+
+#define IDLETIME 50             // mS of idle before partial output is shown, see idlerender()
+#define FOLDTIME 1000           // mS between repeat counts
+#define RATETICK 100            // mS per rate limit budget interval
+
+#define bytes(...) (unsigned char []){__VA_ARGS__}  // define an array of bytes
+
+// Return monotonic mS
+static long long mstime(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000LL + t.tv_nsec / 1000000;
+}
+
+// Write buffered bytes to the output
+static void bflush(render *r, outbuf *b)
+{
+    if (b->len) ((b == &r->conbuf) ? r->conout : r->teeout)(r->arg, b->data, b->len);
+    b->len = 0;
+}
+
+// Append size bytes to buffer, flushing to the output as needed
+static void bput(render *r, outbuf *b, const void *s, size_t size)
+{
+    if (b->len + size > sizeof b->data)
+    {
+        bflush(r, b);
+        if (size > sizeof b->data)
+        {
+            // too big, just write it
+            ((b == &r->conbuf) ? r->conout : r->teeout)(r->arg, s, size);
+            return;
+        }
+    }
+    memcpy(b->data + b->len, s, size);
+    b->len += size;
+}
+
+// put to tee, if any
+static void puttee(render *r, const void *s, size_t size)
+{
+    if (r->teeout) bput(r, &r->teebuf, s, size);
+}
+
+// put to console and maybe tee, if size is 0 use strlen(s)
+static void putcon(render *r, const void *s, size_t size)
+{
+    if (!size) size = strlen(s);
+    if (!r->teeonly) bput(r, &r->conbuf, s, size);
+    puttee(r, s, size);
+}
+
+// write pending console and tee output
+static void flushcon(render *r)
+{
+    bflush(r, &r->conbuf);
+    bflush(r, &r->teebuf);
+}
+
+// put start of new line
+static void startline(render *r)
+{
+    r->column = r->indent = 0;
+    if (r->altscreen) { r->column = -1; return; }       // full-screen app, don't touch it
+    if (r->fx) { putcon(r, "| ", 0); r->dirty = 1; r->column = r->indent = 2; } // indicate FX command output
+    if (!r->timestamp) return;
+    struct timeval t;
+    gettimeofday(&t, NULL);                             // get current time
+    static char s[40];                                  // format it, but only call strftime when the second changes
+    static time_t second = -1;
+    static int format = 0, n;
+    if (t.tv_sec != second || r->timestamp != format)
+    {
+        second = t.tv_sec;
+        format = r->timestamp;
+        n = strftime(s, sizeof(s)-10, (r->timestamp) > 1 ?  "[%Y-%m-%d %H:%M:%S." : "[%H:%M:%S.", localtime(&t.tv_sec));
+    }
+    int ms = t.tv_usec / 1000;
+    memcpy(s + n, (char []){ '0' + ms / 100, '0' + ms / 10 % 10, '0' + ms % 10, ']', ' ' }, 5);
+    putcon(r, s, n + 5);
+    r->column = r->indent += n + 5;
+    r->dirty = 1;
+}
+
+// Return true if console output should be wrapped, get the console width if needed
+static bool wrapping(render *r)
+{
+    if (!r->wrap || r->teeonly || r->column < 0) return false;
+    if (!r->cols && r->columns) r->cols = r->columns(r->arg);
+    return r->cols >= 2;
+}
+
+// Continue on the next console row, indented under the line prefix. The tee doesn't see this.
+static void newrow(render *r)
+{
+    char s[64] = { CR, LF };
+    int n = (r->indent < r->cols / 2 && r->indent < sizeof(s) - 2) ? r->indent : 0; // don't indent if it doesn't fit
+    memset(s + 2, ' ', n);
+    bput(r, &r->conbuf, s, n + 2);
+    r->column = n;
+}
+
+// Return the number of UTF-8 continuation bytes in count characters, eight at a time
+static int contbytes(unsigned char *s, int count)
+{
+    int n = 0, i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, s + i, 8);
+        n += __builtin_popcountll(w & ~(w << 1) & 0x8080808080808080ULL); // bit 7 set and bit 6 clear
+    }
+    for (; i < count; i++) n += (s[i] & 0xC0) == 0x80;
+    return n;
+}
+
+// Return the number of characters that fill at most cols console columns. If multi is true, characters may be UTF-8
+// sequences and are never split.
+static int fitcols(unsigned char *s, int count, int cols, bool multi)
+{
+    if (cols > count) cols = count;
+    if (!multi) return cols;                            // one column per character
+    int n = cols, used = cols - contbytes(s, cols);
+    while (used < cols && n < count)
+    {
+        // each character is at most one column, so add enough for the rest
+        int more = cols - used;
+        if (more > count - n) more = count - n;
+        used += more - contbytes(s + n, more);
+        n += more;
+    }
+    while (n < count && (s[n] & 0xC0) == 0x80) n++;     // finish the last sequence
+    return n;
+}
+
+static void putLF(render *r)
+{
+    if (!r->teeonly) bput(r, &r->conbuf, bytes(CR, LF), 2); // CRLF to console
+    puttee(r, bytes(LF), 1);                            // LF to the tee
+    r->dirty = 0;                                       // not dirty
+    r->column = r->altscreen ? -1 : 0;
+    r->indent = 0;
+}
+
+static void putCR(render *r)
+{
+    if (!r->teeonly) bput(r, &r->conbuf, bytes(CR), 1); // CR to the console
+    puttee(r, bytes(LF), 1);                            // but LF to the tee
+    startline(r);                                       // maybe (re)timestamp
+}
+
+// put character as "[XX]"
+static void putxx(render *r, int c)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    if (wrapping(r) && r->column + 4 > r->cols) newrow(r);
+    if (r->column >= 0) r->column += 4;
+    putcon(r, bytes('[', hex[(c >> 4) & 15], hex[c & 15], ']'), 4);
+    r->dirty = 1;
+}
+
+static int puthex(render *r, int c)
+{
+    if (r->fx) return 0;                                // never hex FX output
+    if (!r->showhex) return 0;                          // done if hex not enabled
+    putxx(r, c);                                        // show "[XX]"
+    return 1;                                           // note slurped
+}
+
+// Put a run of printable and high characters, encoding high characters if enabled. Return the number of characters
+// consumed, stopping at the first character that needs other handling.
+static int putrun(render *r, unsigned char *s, int count)
+{
+    bool high = !r->showhex;                            // high characters are in the run if not shown as hex
+#if TRANSLIT
+    bool enc = r->encode && !r->decoder && !r->utf8;    // decode() and validate() output is already encoded
+    const char *xlatstr = r->xlatstr ?: cp437str;       // loaded charset, or built-in CP437
+    const translit *xlat = r->xlat ?: cp437;
+#endif
+    if (r->fx)
+    {
+        high = true;                                    // FX output displays verbatim
+#if TRANSLIT
+        enc = false;
+#endif
+    }
+
+    bool multi = high;                                  // verbatim high characters may be multi-byte UTF-8
+#if TRANSLIT
+    if (enc) multi = false;
+#endif
+
+    int n = 0;
+    while (n < count)
+    {
+        int c = s[n];
+        if ((c < 32 || c > 126) && (c < 128 || !high)) break; // needs other handling, don't start a row for it
+        int stop = count, first = n;                    // render up to stop, unless wrapped
+        if (wrapping(r))
+        {
+            if (r->column >= r->cols) newrow(r);
+            stop = n + fitcols(s + n, count - n, r->cols - r->column, multi);
+        }
+
+        // render directly into the console buffer, each character needs at most 16 bytes
+        if (r->conbuf.len > sizeof(r->conbuf.data) - 16) bflush(r, &r->conbuf);
+        char *start = r->conbuf.data + r->conbuf.len, *o = start, *end = r->conbuf.data + sizeof(r->conbuf.data) - 16;
+        for (; n < stop && o <= end; n++)
+        {
+            int c = s[n];
+            if (c >= 32 && c <= 126) *o++ = c;
+            else if (c < 128 || !high) break;           // needs other handling
+#if TRANSLIT
+            else if (enc)
+            {
+                memcpy(o, xlatstr + xlat[c & 127].offset, xlat[c & 127].length);
+                o += xlat[c & 127].length;
+            }
+#endif
+            else *o++ = c;                              // verbatim
+        }
+        puttee(r, start, o - start);                    // tee gets the same
+        r->conbuf.len = r->teeonly ? start - r->conbuf.data : o - r->conbuf.data;
+        if (r->column >= 0) r->column += (n - first) - (multi ? contbytes(s + first, n - first) : 0);
+        if (n < stop && o <= end) break;                // stopped on other character
+    }
+    return n;
+}
+
+// put pending hexdump bytes as one line, "OOOOOOOO  XX XX XX XX XX XX XX XX  XX XX XX XX XX XX XX XX  |AAAAAAAAAAAAAAAA|"
+static void putdump(render *r)
+{
+    if (!r->dumplen) return;
+    static const char hex[] = "0123456789ABCDEF";
+    char s[80], *p = s;
+    if (r->dirty) putLF(r);                             // start on a clean line
+    startline(r);                                       // maybe timestamp
+    for (int i = 28; i >= 0; i -= 4) *p++ = hex[(r->dumpoffset >> i) & 15];
+    *p++ = ' ';
+    for (int i = 0; i < 16; i++)
+    {
+        if (!(i & 7)) *p++ = ' ';                       // extra space every 8 bytes
+        if (i < r->dumplen)
+        {
+            *p++ = hex[r->dumpline[i] >> 4];
+            *p++ = hex[r->dumpline[i] & 15];
+        } else
+        {
+            *p++ = ' ';
+            *p++ = ' ';
+        }
+        *p++ = ' ';
+    }
+    *p++ = ' ';
+    *p++ = '|';
+    for (int i = 0; i < r->dumplen; i++) *p++ = (r->dumpline[i] >= 32 && r->dumpline[i] <= 126) ? r->dumpline[i] : '.';
+    *p++ = '|';
+    putcon(r, s, p - s);
+    putLF(r);
+    r->dumpoffset += r->dumplen;
+    r->dumplen = 0;
+}
+
+// put incomplete UTF-8 sequence as hex
+static void putpartial(render *r)
+{
+    if (!r->partlen) return;
+    if (!r->dirty) startline(r);                        // timestamp a blank line
+    else if (r->dirty > 1) putCR(r);                    // or CR if deferred
+    for (int i = 0; i < r->partlen; i++) putxx(r, r->partial[i]);
+    r->partlen = 0;
+}
+
+// Add count characters to the hexdump, showing each line as it fills
+static void dump(render *r, unsigned char *s, int count)
+{
+    while (count)
+    {
+        int n = sizeof(r->dumpline) - r->dumplen;
+        if (n > count) n = count;
+        memcpy(r->dumpline + r->dumplen, s, n);
+        r->dumplen += n;
+        s += n;
+        count -= n;
+        if (r->dumplen == sizeof(r->dumpline)) putdump(r);
+    }
+}
+
+// Act on the final character of a CSI sequence
+static void csi(render *r, int c)
+{
+    r->escparam[r->esclen] = 0;
+    switch(c)
+    {
+        case 'A' ... 'H':                               // cursor movement
+        case 'a':
+        case 'd':
+        case 'e':
+        case 'f':
+        case '`':
+            r->dirty = 1;                               // no prefix until next LF
+            r->column = -1;                             // and no wrapping
+            break;
+
+        case 'h':                                       // set or reset mode
+        case 'l':
+            if (*r->escparam != '?') break;
+            for (char *p = r->escparam + 1; *p; p += (*p == ';'))
+            {
+                int m = strtol(p, &p, 10);
+                if (m == 47 || m == 1047 || m == 1049) r->altscreen = (c == 'h');
+                if (*p && *p != ';') break;             // malformed
+            }
+            break;
+    }
+}
+
+// Put an escape sequence to the console verbatim, starting at ESC or continuing one from the last chunk. Return the
+// number of characters consumed. Sequences are scanned in runs so they can be put at once, line prefixes are never
+// inserted into them, and sequences that move the cursor suppress the prefix until the next LF.
+static int putesc(render *r, unsigned char *s, int count)
+{
+    int n = 0;
+    if (!r->escstate)
+    {
+        if (r->dirty > 1)
+        {
+            // deferred CR, but leave the prefix for the next printable
+            if (!r->teeonly) bput(r, &r->conbuf, bytes(CR), 1);
+            puttee(r, bytes(LF), 1);
+            r->dirty = 0;
+            r->column = 0;
+        }
+        r->escstate = 1;
+        n = 1;                                          // the ESC
+    }
+    while (r->escstate && n < count)
+    {
+        int c = s[n];
+        switch(r->escstate)
+        {
+            case 1:                                     // after ESC
+                if (c < 32) r->escstate = 0;            // broken, let caller handle it
+                else if (c == '[') r->escstate = 2, r->esclen = 0, n++;
+                else if (c == ']' || c == 'P' || c == 'X' || c == '^' || c == '_') r->escstate = 3, n++;
+                else if (c < 48) n++;                   // intermediate, e.g. ESC ( B
+                else
+                {
+                    // single character final
+                    if (c == '7' || c == '8' || c == 'D' || c == 'E' || c == 'M') csi(r, 'H');
+                    r->escstate = 0;
+                    n++;
+                }
+                break;
+
+            case 2:                                     // CSI, parameters and intermediates then final
+                while (n < count && s[n] >= 32 && s[n] < 64)
+                {
+                    if (r->esclen < ESCMAX) r->escparam[r->esclen++] = s[n];
+                    n++;
+                }
+                if (n == count) break;
+                if (s[n] >= 64 && s[n] <= 126) csi(r, s[n++]);
+                r->escstate = 0;                        // done, or broken
+                break;
+
+            case 3:                                     // string, ends with BEL or ESC backslash
+                while (n < count && s[n] != 7 && s[n] != ESC) n++;
+                if (n == count) break;
+                r->escstate = (s[n++] == ESC) ? 4 : 0;
+                break;
+
+            case 4:                                     // ESC in string
+                if (s[n] == '\\') n++;
+                r->escstate = 0;
+                break;
+        }
+    }
+    if (n) putcon(r, s, n);
+    return n;
+}
+
+// Render count characters with timestamps, high-character encoding and hex conversion, into the console and tee
+// buffers.
+static void draw(render *r, unsigned char *s, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int c = s[i];
+
+        if (r->escstate)                                    // escape sequence from the last chunk
+        {
+            i += putesc(r, s + i, count - i) - 1;
+            continue;
+        }
+
+        if (r->showhex > 1 && puthex(r, c)) continue;       // done if show all as hex
+
+        switch(c)
+        {
+            case LF:                                        // LF
+                if (!r->dirty) startline(r);                // timestamp a blank line
+                putLF(r);
+                continue;
+
+            case CR:                                        // CR
+                if (puthex(r, c)) continue;                 // done if shown as hex
+                if (r->dirty) r->dirty = 2;                 // ignore if clean else defer until next
+                continue;
+
+            case ESC:                                       // escape sequence
+                if (puthex(r, c)) continue;                 // done if shown as hex
+                i += putesc(r, s + i, count - i) - 1;       // put the entire sequence at once
+                continue;
+
+            case TAB:                                       // various printables
+            case FF:
+                if (puthex(r, c)) continue;                 // done if shown as hex
+                // fall through
+            case BS:
+                if (!r->dirty) startline(r);                // timestamp a blank line
+                else if (r->dirty > 1) putCR(r);            // or CR if deferred
+                break;
+
+            case 128 ... 255:                               // high characters
+                if (puthex(r, c)) continue;                 // done if shown as hex
+                // fall through
+            case 32 ... 126:
+                if (!r->dirty) startline(r);                // timestamp a blank line
+                else if (r->dirty > 1) putCR(r);            // or CR if deferred
+                i += putrun(r, s + i, count - i) - 1;       // put the entire run at once
+                r->dirty = 1;
+                continue;
+
+            default:                                        // all others
+                puthex(r, c);                               // maybe show hex
+                continue;
+        }
+
+        // put character to the display
+        putcon(r, bytes(c), 1);
+        r->dirty = 1;
+        if (r->column >= 0) r->column = (c == TAB) ? (r->column | 7) + 1 : (c == BS) ? r->column - (r->column > 0) : -1; // FF moves down
+    }
+}
+
+#if TRANSLIT
+// Convert count characters of a multi-byte charset with a single iconv() call per chunk and render the result. An
+// incomplete sequence at the end is carried over to the next call, invalid sequences are shown as '?'.
+static void decode(render *r, unsigned char *s, int count)
+{
+    unsigned char in[sizeof(r->carry) + 1024];
+    char out[4 * sizeof(in)];
+    while (count)
+    {
+        int n = sizeof(in) - r->carried;
+        if (n > count) n = count;
+        memcpy(in, r->carry, r->carried);                   // prepend carried bytes
+        memcpy(in + r->carried, s, n);
+        s += n;
+        count -= n;
+
+        char *ip = (char *)in, *op = out;
+        size_t nin = r->carried + n, nout = sizeof(out);
+        while (nin && iconv(r->decoder, &ip, &nin, &op, &nout) == (size_t)-1)
+        {
+            if (errno == EINVAL) break;                     // incomplete sequence, carry it
+            if (errno != E2BIG)
+            {
+                // invalid sequence, skip a byte
+                *op++ = '?';
+                nout--;
+                ip++;
+                nin--;
+            }
+            if (errno == E2BIG || nout < 16)
+            {
+                // make room
+                draw(r, (unsigned char *)out, op - out);
+                op = out;
+                nout = sizeof(out);
+            }
+        }
+        draw(r, (unsigned char *)out, op - out);
+
+        if (nin > sizeof(r->carry)) nin = 0;                // can't happen
+        memcpy(r->carry, ip, nin);
+        r->carried = nin;
+    }
+}
+#endif
+
+// Return length of the valid UTF-8 sequence at s, 0 if invalid, or -1 if valid but incomplete
+static int utf8len(unsigned char *s, int count)
+{
+    int c = s[0], n;
+    unsigned char lo = 0x80, hi = 0xBF;                 // range of the second byte
+    if (c < 0x80) return 1;
+    else if (c < 0xC2) return 0;
+    else if (c < 0xE0) n = 2;
+    else if (c < 0xF0)
+    {
+        n = 3;
+        if (c == 0xE0) lo = 0xA0;                       // overlong
+        else if (c == 0xED) hi = 0x9F;                  // surrogates
+    }
+    else if (c < 0xF5)
+    {
+        n = 4;
+        if (c == 0xF0) lo = 0x90;                       // overlong
+        else if (c == 0xF4) hi = 0x8F;                  // > U+10FFFF
+    }
+    else return 0;
+
+    for (int i = 1; i < n; i++)
+    {
+        if (i >= count) return -1;                      // so far so good
+        if (s[i] < lo || s[i] > hi) return 0;
+        lo = 0x80;
+        hi = 0xBF;
+    }
+    return n;
+}
+
+// Validate count characters as UTF-8, render valid runs and show invalid characters as hex. An incomplete sequence
+// at the end is saved in partial.
+static void validutf8(render *r, unsigned char *s, int count)
+{
+    int i = 0, start = 0;
+    while (i < count)
+    {
+        // skip ASCII eight bytes at a time
+        uint64_t w;
+        while (i + 8 <= count && (memcpy(&w, s + i, 8), !(w & 0x8080808080808080ULL))) i += 8;
+        if (i >= count) break;
+        if (s[i] < 0x80) { i++; continue; }
+
+        int n = utf8len(s + i, count - i);
+        if (n > 0) { i += n; continue; }                // valid multi-byte sequence
+
+        draw(r, s + start, i - start);                  // render everything before it
+        if (n < 0)
+        {
+            // incomplete, save it for next time
+            memcpy(r->partial, s + i, count - i);
+            r->partlen = count - i;
+            return;
+        }
+        if (!r->dirty) startline(r);                    // timestamp a blank line
+        else if (r->dirty > 1) putCR(r);                // or CR if deferred
+        putxx(r, s[i++]);                               // show invalid as hex
+        start = i;
+    }
+    draw(r, s + start, i - start);
+}
+
+// Validate UTF-8, first completing any partial sequence from the last chunk
+static void validate(render *r, unsigned char *s, int count)
+{
+    while (r->partlen && count)
+    {
+        unsigned char in[sizeof(r->partial) + 1024];
+        int n = (count < 1024) ? count : 1024, p = r->partlen;
+        memcpy(in, r->partial, p);
+        memcpy(in + p, s, n);
+        r->partlen = 0;
+        validutf8(r, in, p + n);
+        s += n;
+        count -= n;
+    }
+    if (count) validutf8(r, s, count);
+}
+
+// Render text via decoder or UTF-8 validator, if enabled
+static void text(render *r, unsigned char *s, int count)
+{
+#if TRANSLIT
+    if (r->decoder && r->encode && !r->showhex) decode(r, s, count);
+    else
+#endif
+    if (r->utf8 && !r->showhex) validate(r, s, count);
+    else draw(r, s, count);
+}
+
+// Show the repeat count, if any. Cursor is known clean.
+static void putrepeats(render *r)
+{
+    if (!r->repeats) return;
+    char s[40];
+    int n = sprintf(s, "| last line repeated %d time%s", r->repeats, (r->repeats > 1) ? "s" : "");
+    if (!r->teeonly)
+    {
+        bput(r, &r->conbuf, s, n);
+        bput(r, &r->conbuf, bytes(CR, LF), 2);
+    }
+    if (r->foldtee)
+    {
+        puttee(r, s, n);
+        puttee(r, bytes(LF), 1);
+    }
+    r->repeats = 0;
+}
+
+// Show held part of current line, it's no longer a repeat candidate
+static void putheld(render *r)
+{
+    if (!r->held) return;
+    putrepeats(r);
+    r->held = false;
+    text(r, r->foldline, r->curlen);
+}
+
+// Pass text through, but drop lines that are identical to the previous line and count them instead. The current
+// line is held back while it matches the last line.
+static void fold(render *r, unsigned char *s, int count)
+{
+    while (count)
+    {
+        unsigned char *lf = memchr(s, LF, count);
+        int n = lf ? lf - s + 1 : count;            // through the next LF, if any
+
+        if (r->held)
+        {
+            if (r->curlen + n <= r->lastlen && !memcmp(r->foldline + r->curlen, s, n))
+            {
+                // still matches
+                r->curlen += n;
+                if (lf)
+                {
+                    // it's a repeat
+                    long long now = mstime();
+                    if (!r->repeats) r->foldtime = now;
+                    r->repeats++;
+                    if (r->teeout && !r->foldtee)
+                    {
+                        // tee gets it anyway
+                        bool was = r->teeonly;
+                        r->teeonly = true;
+                        text(r, r->foldline, r->lastlen);
+                        r->teeonly = was;
+                    }
+                    if (now - r->foldtime >= FOLDTIME) putrepeats(r); // show count periodically during a flood
+                    r->curlen = 0;
+                }
+                s += n;
+                count -= n;
+                continue;
+            }
+            putheld(r);                             // different, show what was held
+        }
+
+        text(r, s, n);
+        if (r->curlen + n <= FOLDMAX) memcpy(r->foldline + r->curlen, s, n);
+        r->curlen = (r->curlen + n <= FOLDMAX) ? r->curlen + n : FOLDMAX + 1;
+        if (lf)
+        {
+            // next line is a candidate if this one fits
+            r->lastlen = (r->curlen <= FOLDMAX) ? r->curlen : 0;
+            r->curlen = 0;
+            r->held = r->lastlen > 0;
+        }
+        s += n;
+        count -= n;
+    }
+}
+
+// Show held line and repeat count, and forget the last line
+static void unfold(render *r)
+{
+    putheld(r);
+    putrepeats(r);
+    r->lastlen = 0;
+    r->curlen = 0;
+}
+
+// Show count of skipped bytes and lines on the console
+static void putskipped(render *r)
+{
+    if (!r->skipbytes) return;
+    char s[64];
+    int n = sprintf(s, "| skipped %lu bytes (%lu lines)", r->skipbytes, r->skiplines);
+    bput(r, &r->conbuf, s, n);
+    bput(r, &r->conbuf, bytes(CR, LF), 2);
+    r->skipbytes = r->skiplines = 0;
+}
+
+// Stop skipping console output
+static void unskip(render *r)
+{
+    if (!r->skipping) return;
+    r->skipping = false;
+    putskipped(r);
+}
+
+// Given count characters about to be shown, return true if they should be skipped on the console because they exceed
+// the rate limit. Skipping continues until an interval is within budget, or idlerender().
+static bool skip(render *r, unsigned char *s, int count)
+{
+    if (!r->ratelimit) { unskip(r); return false; }
+
+    int budget = r->ratelimit * RATETICK / 1000 ?: 1;
+    long long now = mstime();
+    if (now - r->ratetick >= RATETICK)
+    {
+        // new interval, stop skipping if the last one was within budget
+        if (r->ratebytes <= budget) unskip(r);
+        r->ratetick = now;
+        r->ratebytes = 0;
+    }
+    r->ratebytes += count;
+    if (!r->skipping)
+    {
+        if (r->ratebytes <= budget) return false;
+        r->skipping = true;
+        r->skiptime = now;
+        if (r->dirty) bput(r, &r->conbuf, bytes(CR, LF), 2); // leave console cursor clean
+    }
+
+    r->skipbytes += count;
+    for (unsigned char *p = s; (p = memchr(p, LF, s + count - p)); p++) r->skiplines++;
+    if (now - r->skiptime >= 1000)
+    {
+        // report once a second during a flood
+        putskipped(r);
+        r->skiptime = now;
+    }
+    return true;
+}
+
+
+// Render target output
+void showrender(render *r, unsigned char *s, int count)
+{
+    if (r->fx) draw(r, s, count);                           // FX output is never dumped, decoded or skipped
+    else
+    {
+        r->teeonly = skip(r, s, count);                     // maybe over the rate limit
+        if (r->showhex > 2) dump(r, s, count);
+        else if (r->folding) fold(r, s, count);
+        else text(r, s, count);
+        r->teeonly = false;
+    }
+    flushcon(r);
+    r->lastshow = mstime();
+}
+
+// Show pending output once idle
+void idlerender(render *r)
+{
+    long long now = mstime();
+    if (now - r->lastshow >= IDLETIME)
+    {
+        unskip(r);                                          // flood is over
+        putdump(r);                                         // show partial hexdump line
+        if (r->curlen) putheld(r);                          // and held line
+    }
+    if (r->repeats && now - r->foldtime >= FOLDTIME) putrepeats(r); // and repeat count
+    flushcon(r);
+}
+
+// Return mS until idlerender() should be called, or -1 if nothing is pending
+int duerender(render *r)
+{
+    if (!r->dumplen && !(r->held && r->curlen) && !r->repeats && !r->skipping) return -1;
+    long long now = mstime(), t = r->lastshow + IDLETIME;
+    if (r->repeats && r->foldtime + FOLDTIME < t) t = r->foldtime + FOLDTIME;
+    return (t > now) ? t - now : 0;
+}
+
+// Show everything pending and clean the cursor
+void flushrender(render *r)
+{
+    unskip(r);                                              // stop skipping
+    putdump(r);                                             // show partial hexdump line
+    unfold(r);                                              // and held line
+    putpartial(r);                                          // and incomplete UTF-8
+    if (r->dirty) putLF(r);                                 // make the cursor clean
+    flushcon(r);
+}
+
+// Show note on a line of its own
+void noterender(render *r, char *note)
+{
+    if (r->dirty) bput(r, &r->conbuf, bytes(CR, LF), 2);   // start on a clean line
+    r->dirty = 0;
+    r->column = r->altscreen ? -1 : 0;
+    r->indent = 0;
+    bput(r, &r->conbuf, note, strlen(note));
+    bput(r, &r->conbuf, bytes(CR, LF), 2);
+    flushcon(r);
+}
+
+// If charset is not CP437, use iconv to build its transliteration table. Or, if charset has multi-byte sequences, keep
+// the iconv context for decode(). This is done once, when encoding is first enabled.
+bool charsetrender(render *r)
+{
+    r->carried = 0;                                         // discard stale partial sequence
+#if TRANSLIT
+    if (r->xlatstr || r->decoder || !r->charset || !strcasecmp(r->charset, "CP437")) return true;
+
+    setlocale(LC_CTYPE, "");
+    iconv_t cd = iconv_open("//TRANSLIT", r->charset);
+    setlocale(LC_CTYPE, "C");
+    if (cd == (iconv_t)-1) return false;
+
+    translit *table = malloc(128 * sizeof(translit));
+    char *str = malloc(128 * 16);                           // room for 16 bytes per character
+    if (!table || !str) abort();                            // abort on OOM
+    char *out = str;
+    size_t nout = 128 * 16;
+    for (int n = 128; n < 256; n++)
+    {
+        // Get the unicode string for each high char
+        char ch = n, *in = &ch;
+        size_t nin = 1, was = nout;
+        if (iconv(cd, &in, &nin, &out, &nout) == (size_t)-1 || nin || nout == was)
+        {
+            // not a single-byte charset, decode it as a stream
+            iconv(cd, NULL, NULL, NULL, NULL);              // reset conversion state
+            free(table);
+            free(str);
+            r->decoder = cd;
+            return true;
+        }
+        table[n & 127] = (translit){ .offset = out - str - (was - nout), .length = was - nout };
+    }
+    iconv_close(cd);
+    r->xlatstr = str;
+    r->xlat = table;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Free the loaded charset
+void freerender(render *r)
+{
+#if TRANSLIT
+    if (r->decoder) iconv_close(r->decoder);
+#endif
+    free((void *)r->xlatstr);
+    free((void *)r->xlat);
+    r->decoder = NULL;
+    r->xlatstr = NULL;
+    r->xlat = NULL;
+}
@@ -0,0 +1,101 @@
+// Console renderer, turns target output into console and tee output with timestamps, hex, hexdump, UTF-8
+// validation, high-character encoding, repeated line folding, rate limiting and wrapping
+
+#include <stdbool.h>
+
+// Offset and length of the UTF-8 sequence for a high character, in a string of concatenated sequences
+typedef struct
+{
+    unsigned short offset;
+    unsigned char length;
+} translit;
+
+// Output buffer, accumulates rendered characters so they can be written in bulk
+typedef struct
+{
+    int len;                    // number of buffered bytes
+    char data[4096];            // buffered bytes
+} outbuf;
+
+#define FOLDMAX 256             // longest line that can be folded, including LF
+#define ESCMAX 16               // longest CSI parameter string that is parsed
+
+// Renderer state. Zero is the default for each field, options may be changed between calls.
+typedef struct
+{
+    // options
+    int showhex;                // 1 = show unprintable as hex, 2 = show all as hex, 3 = show all as hexdump
+    bool utf8;                  // true = show valid UTF-8 verbatim and invalid high characters as hex
+    bool folding;               // true = fold repeated lines on console
+    bool foldtee;               // true = also fold repeated lines in tee
+    int ratelimit;              // maximum console characters per second, 0 = unlimited
+    bool wrap;                  // true = wrap long lines on console, if columns() is set
+    int timestamp;              // 1 = show time, 2 = show date and time
+    bool encode;                // true = show high characters in charset, see charsetrender()
+    char *charset;              // iconv character set for encode, NULL = CP437
+    bool fx;                    // true = show output verbatim, with a "| " prefix and never dumped, decoded or skipped
+
+    // outputs
+    void (*conout)(void *arg, const void *data, int count); // rendered console output
+    void (*teeout)(void *arg, const void *data, int count); // same without wrapping or skipping, NULL = none
+    int (*columns)(void *arg);  // return console width, or 0 if unknown
+    void *arg;                  // passed to the above
+    int cols;                   // console width from columns(), 0 = get it again e.g. after SIGWINCH
+    int dirty;                  // cursor state: 0 = clean, 1 = dirty, 2 = dirty with deferred CR
+
+    // internal state, see render.c
+    bool teeonly;               // true = render to the tee but not the console
+    outbuf conbuf, teebuf;      // pending console and tee output
+    const char *xlatstr;        // loaded charset's UTF-8 sequences for high characters, NULL = CP437
+    const translit *xlat;       // offset and length of each sequence in xlatstr
+    void *decoder;              // iconv context for a multi-byte charset, if not NULL then xlat is not used
+    unsigned char carry[16];    // incomplete multi-byte sequence from the end of the last chunk
+    int carried;                // number of bytes in carry
+    unsigned char dumpline[16]; // bytes waiting to be dumped
+    int dumplen;                // number of bytes in dumpline
+    unsigned long dumpoffset;   // stream offset of dumpline[0]
+    unsigned char partial[4];   // incomplete UTF-8 sequence from the end of the last chunk
+    int partlen;                // number of bytes in partial
+    unsigned char foldline[FOLDMAX]; // last line, or current line once it differs from the last line
+    int lastlen;                // length of last line, 0 if none or too long
+    int curlen;                 // length of current line so far, > FOLDMAX if too long
+    bool held;                  // true if current line matches last line so far and has not been shown
+    int repeats;                // number of times last line has been repeated and not shown
+    long long foldtime;         // mstime of first repeat
+    long long ratetick;         // mstime of current rate limit interval
+    int ratebytes;              // bytes received in current interval
+    bool skipping;              // true if console output is being skipped
+    long long skiptime;         // mstime of last skip report
+    unsigned long skipbytes;    // bytes skipped since last report
+    unsigned long skiplines;    // lines skipped since last report
+    int escstate;               // 0 = none, 1 = after ESC, 2 = in CSI, 3 = in string (OSC, DCS, etc), 4 = ESC in string
+    char escparam[ESCMAX + 1];  // CSI parameter bytes
+    int esclen;                 // number of bytes in escparam
+    bool altscreen;             // true if target is using the alternate screen, line prefixes are suppressed
+    int column;                 // console cursor column, -1 if unknown
+    int indent;                 // width of line prefix, continuation lines are indented this much
+    long long lastshow;         // mstime of last showrender()
+} render;
+
+// Render count characters of target output to conout() and teeout().
+void showrender(render *r, unsigned char *data, int count);
+
+// Show output that has been pending since the target went idle: partial hexdump line, held line, repeat count and
+// skip count.
+void idlerender(render *r);
+
+// Return mS until idlerender() should be called, or -1 if nothing is pending.
+int duerender(render *r);
+
+// Show everything pending, including incomplete UTF-8, and leave the cursor on a clean line. Call before anything
+// else writes to the console.
+void flushrender(render *r);
+
+// Show note on the console only, on a line of its own.
+void noterender(render *r, char *note);
+
+// Prepare charset for encode, call before setting it. Return false if charset is not supported.
+bool charsetrender(render *r);
+
+// Free the loaded charset, the renderer can still be used
+void freerender(render *r);
@@ -0,0 +1,112 @@
+// Line-oriented scrollback ring
+
+#define _GNU_SOURCE // for memmem()
+#include <stdlib.h>
+#include <string.h>
+#include "ring.h"
+
+// Allocate ring to hold size bytes
+void initring(ring *r, int size)
+{
+    freering(r);
+    if (size < 64) size = 64;
+    r->size = size;
+    r->maxlines = size / 16;                        // assume lines average at least 16 bytes
+    r->data = malloc(size);
+    r->index = malloc(r->maxlines * sizeof(*r->index));
+    r->scratch = malloc(size / 2 + 1);
+    if (!r->data || !r->index || !r->scratch) abort(); // abort on OOM
+}
+
+// Discard the oldest complete line
+static void discard(ring *r)
+{
+    int length = r->index[r->first].length;
+    r->head = (r->head + length) % r->size;
+    r->count -= length;
+    r->first = (r->first + 1) % r->maxlines;
+    r->lines--;
+}
+
+// Append count bytes to the partial line, making room as needed
+static void append(ring *r, char *data, int count)
+{
+    while (r->lines && r->count + count > r->size) discard(r);
+    int tail = (r->head + r->count) % r->size;
+    int n = r->size - tail;                         // bytes before the end of data
+    if (n > count) n = count;
+    memcpy(r->data + tail, data, n);
+    memcpy(r->data, data + n, count - n);           // wrap the rest, if any
+    r->count += count;
+    r->partial += count;
+}
+
+// Add count bytes of data to ring, discarding the oldest lines to make room
+void putring(ring *r, void *data, int count)
+{
+    if (!r->size) return;
+    while (count)
+    {
+        char *lf = memchr(data, '\n', count);
+        int n = lf ? lf - (char *)data + 1 : count; // through the next LF, if any
+
+        int keep = r->size / 2 - r->partial;        // maximum bytes that can be added to the partial line
+        if (keep > n) keep = n;
+        if (keep > 0) append(r, data, keep);
+        if (lf)
+        {
+            if (keep < n) append(r, "\n", 1);       // truncated, but still end with LF
+            // add the partial line to the index
+            if (r->lines == r->maxlines) discard(r);
+            int i = (r->first + r->lines) % r->maxlines;
+            r->index[i].start = (r->head + r->count - r->partial) % r->size;
+            r->index[i].length = r->partial;
+            r->lines++;
+            r->partial = 0;
+        }
+        data += n;
+        count -= n;
+    }
+}
+
+// Point *line at the nth complete line and return its length, or -1 if no such line
+int getring(ring *r, int n, char **line)
+{
+    if (n < 0 || n >= r->lines) return -1;
+    int i = (r->first + n) % r->maxlines;
+    int start = r->index[i].start, length = r->index[i].length;
+    if (start + length <= r->size)
+        *line = r->data + start;                    // contiguous
+    else
+    {
+        // wraps, make a copy
+        int n = r->size - start;
+        memcpy(r->scratch, r->data + start, n);
+        memcpy(r->scratch + n, r->data, length - n);
+        *line = r->scratch;
+    }
+    return length;
+}
+
+// Return the index of the first complete line at or after the nth that contains string, or -1 if none
+int findring(ring *r, int n, char *string)
+{
+    int size = strlen(string);
+    if (n < 0) n = 0;
+    for (; n < r->lines; n++)
+    {
+        char *line;
+        int length = getring(r, n, &line);
+        if (memmem(line, length, string, size)) return n;
+    }
+    return -1;
+}
+
+// Wipe ring and free malloc'd buffers
+void freering(ring *r)
+{
+    free(r->data);    // OK if NULL
+    free(r->index);
+    free(r->scratch);
+    *r = (ring){0};
+}
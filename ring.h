@@ -0,0 +1,39 @@
+// Line-oriented scrollback ring
+
+typedef struct
+{
+    char *data;             // malloced data buffer
+    int size,               // size of data allocation, 0 if not initialized
+        head,               // oldest byte is at data+head
+        count,              // number of bytes in ring
+        partial;            // number of bytes at the end that aren't a complete line yet
+    struct
+    {
+        int start,          // offset of line in data
+            length;         // length of line including LF
+    } *index;               // malloced ring of complete lines
+    int maxlines,           // size of index allocation
+        first,              // oldest line is at index+first
+        lines;              // number of complete lines
+    char *scratch;          // malloced buffer for lines that wrap around the end of data
+} ring;
+
+// Allocate ring to hold size bytes.
+void initring(ring *r, int size);
+
+// Add count bytes of data to ring, discarding the oldest lines to make room. Lines longer than half the ring are
+// truncated.
+void putring(ring *r, void *data, int count);
+
+// Point *line at the nth complete line (0 is oldest) and return its length including LF, or -1 if no such line. The
+// line is only valid until the next putring().
+int getring(ring *r, int n, char **line);
+
+// Return the index of the first complete line at or after the nth that contains string, or -1 if none.
+int findring(ring *r, int n, char *string);
+
+// Wipe ring and free malloc'd buffers
+void freering(ring *r);
+
+// Number of complete lines in ring
+#define linesring(r) ((r)->lines)
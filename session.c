@@ -0,0 +1,279 @@
+// Detachable session support, a daemon relays a pty to attached clients, like dtach
+
+#define _GNU_SOURCE // for accept4()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "session.h"
+
+static pid_t relay = 0;                 // daemon pid, in the session process
+
+// Output ring, the client is always fed directly from here
+static char *data;                      // malloced ring buffer
+static int size,                        // size of data
+           head,                        // oldest byte is at data+head
+           count,                       // number of bytes in ring
+           lag;                         // number of newest bytes not yet sent to client
+static bool wrapped = false;            // true if old output has been discarded
+
+static int client = -1;                 // attached client socket, or -1
+static volatile sig_atomic_t detach = 0; // set by SIGUSR1
+
+static void set_detach(int sig) { detach = 1; }
+
+// Fill in Unix socket address for path, return false if path is too long
+static bool address(struct sockaddr_un *a, char *path)
+{
+    memset(a, 0, sizeof(*a));
+    a->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(a->sun_path)) { errno = ENAMETOOLONG; return false; }
+    strcpy(a->sun_path, path);
+    return true;
+}
+
+// Send as much of the last lag bytes of the ring as client will take, without copying
+static void feed(void)
+{
+    if (client < 0 || !lag) return;
+    int start = (head + count - lag) % size, first = size - start;
+    if (first > lag) first = lag;
+    struct iovec v[2] = { { data + start, first }, { data, lag - first } };
+    int n = writev(client, v, 2);
+    if (n > 0) lag -= n;
+    else if (n < 0 && errno != EAGAIN && errno != EINTR)
+    {
+        close(client);                  // client is gone
+        client = -1;
+    }
+}
+
+// Read pty output into the ring, return false if session has ended
+static bool fill(int master)
+{
+    int tail = (head + count) % size, n = size - tail;
+    if (n > 4096) n = 4096;
+    n = read(master, data + tail, n);
+    if (n <= 0) return n < 0 && errno == EINTR;
+    count += n;
+    if (count > size)
+    {
+        // overwrote the oldest
+        head = (head + count - size) % size;
+        count = size;
+        wrapped = true;
+    }
+    if (client >= 0) lag = (lag + n < count) ? lag + n : count;
+    return true;
+}
+
+// Accept a new client, replacing the old one, and replay the ring
+static void accept_client(int listener, int master)
+{
+    int c = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+    if (c < 0) return;
+    if (client >= 0) close(client);     // attached elsewhere
+    client = c;
+
+    // client sends its window size first
+    struct winsize ws;
+    struct pollfd p = { .fd = client, .events = POLLIN };
+    if (poll(&p, 1, 1000) == 1 && read(client, &ws, sizeof(ws)) == sizeof(ws) && ws.ws_row && ws.ws_col)
+        ioctl(master, TIOCSWINSZ, &ws);
+    fcntl(client, F_SETFL, O_NONBLOCK);
+
+    // replay everything, but start on a line if the oldest output was discarded
+    lag = count;
+    if (wrapped)
+        for (int i = 0; i < count - 1; i++)
+            if (data[(head + i) % size] == '\n') { lag = count - i - 1; break; }
+    feed();
+}
+
+// Relay between pty master and clients until the session ends
+static void run_relay(int listener, int master, char *path)
+{
+    signal(SIGPIPE, SIG_IGN);
+    sigaction(SIGUSR1, &(struct sigaction){ .sa_handler = set_detach }, NULL); // no SA_RESTART, interrupt poll
+    while (1)
+    {
+        if (detach && client >= 0)
+        {
+            close(client);
+            client = -1;
+        }
+        detach = 0;
+
+        struct pollfd p[] = { { .fd = listener, .events = POLLIN },
+                              { .fd = master, .events = POLLIN },
+                              { .fd = client, .events = lag ? POLLIN|POLLOUT : POLLIN } };
+        if (poll(p, 3, 1000) <= 0) continue;   // SIGUSR1 or timeout, check detach again
+
+        if (p[0].revents) accept_client(listener, master);
+
+        if (p[1].revents && !fill(master)) break;
+
+        if (p[2].revents & POLLOUT) feed();
+        if (client >= 0 && p[2].revents & (POLLIN|POLLHUP|POLLERR))
+        {
+            // keys to the session
+            char buf[1024];
+            int n = read(client, buf, sizeof buf);
+            if (n > 0) write(master, buf, n);
+            else if (!n || errno != EAGAIN)
+            {
+                close(client);          // client detached itself
+                client = -1;
+            }
+        }
+    }
+
+    // session ended, give the client the rest
+    unlink(path);
+    if (client >= 0)
+    {
+        fcntl(client, F_SETFL, 0);
+        while (client >= 0 && lag) feed();
+    }
+    while (waitpid(-1, NULL, WNOHANG) > 0);
+    exit(0);
+}
+
+// Start session daemon, return in the session process
+void start_session(char *path, int ringsize)
+{
+    struct sockaddr_un a;
+    if (!address(&a, path)) { perror(path); exit(1); }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+    if (listener < 0) { perror("socket"); exit(1); }
+    if (!connect(listener, (struct sockaddr *)&a, sizeof(a)))
+    {
+        fprintf(stderr, "Session %s is already running\n", path);
+        exit(1);
+    }
+    close(listener);
+
+    // listen before forking, so the attach below can't miss
+    listener = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+    unlink(path);                       // stale
+    if (bind(listener, (struct sockaddr *)&a, sizeof(a)) || listen(listener, 4)) { perror(path); exit(1); }
+
+    size = ringsize;
+    data = malloc(size);
+    if (!data) abort();                 // abort on OOM
+
+    struct winsize ws, *wsp = ioctl(STDIN_FILENO, TIOCGWINSZ, &ws) ? NULL : &ws;
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); exit(1); }
+    if (pid)
+    {
+        // this process is just the first client
+        close(listener);
+        exit(attach_session(path) ? 1 : 0);
+    }
+
+    // daemon
+    setsid();
+    int master, slave;
+    if (openpty(&master, &slave, NULL, NULL, wsp)) exit(1);
+    fcntl(master, F_SETFD, FD_CLOEXEC);
+    pid = fork();
+    if (pid < 0) exit(1);
+    if (!pid)
+    {
+        // session process, carry on with pty as controlling tty and console
+        close(listener);
+        close(master);
+        setsid();
+        ioctl(slave, TIOCSCTTY, 0);
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        if (slave > STDERR_FILENO) close(slave);
+        relay = getppid();
+        return;
+    }
+
+    close(slave);
+    int null = open("/dev/null", O_RDWR);
+    dup2(null, STDIN_FILENO);           // let go of the original tty
+    dup2(null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    if (null > STDERR_FILENO) close(null);
+    run_relay(listener, master, path);
+}
+
+// Attach current tty to session
+int attach_session(char *path)
+{
+    struct sockaddr_un a;
+    if (!address(&a, path)) return -1;
+    int s = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+    if (s < 0) return -1;
+    if (connect(s, (struct sockaddr *)&a, sizeof(a))) { close(s); return -1; }
+
+    struct winsize ws = {0};
+    ioctl(STDIN_FILENO, TIOCGWINSZ, &ws);
+    write(s, &ws, sizeof(ws));
+
+    // the session does all the terminal processing
+    struct termios cooked, raw;
+    bool tty = !tcgetattr(STDIN_FILENO, &cooked);
+    if (tty)
+    {
+        raw = cooked;
+        cfmakeraw(&raw);
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    }
+
+    struct pollfd p[] = { { .fd = STDIN_FILENO, .events = POLLIN },
+                          { .fd = s, .events = POLLIN } };
+    char buf[4096];
+    while (1)
+    {
+        if (poll(p, 2, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (p[0].revents)
+        {
+            int n = read(STDIN_FILENO, buf, sizeof buf);
+            if (n <= 0) p[0].fd = -1;   // no more keys, but keep showing output
+            else if (write(s, buf, n) != n) break;
+        }
+        if (p[1].revents)
+        {
+            int n = read(s, buf, sizeof buf);
+            if (n <= 0) break;          // detached or ended
+            for (int o = 0, w; o < n; o += w) if ((w = write(STDOUT_FILENO, buf + o, n - o)) <= 0) goto out;
+        }
+    }
+    out:
+    if (tty) tcsetattr(STDIN_FILENO, TCSANOW, &cooked);
+    close(s);
+    if (access(path, F_OK)) printf("\r\n| Session %s has ended.\n", path); // daemon removes the socket when it's done
+    else printf("\r\n| Detached, 'nanocom -a %s' to reattach.\n", path);
+    return 0;
+}
+
+// Ask daemon to detach client
+void detach_session(void)
+{
+    if (relay) kill(relay, SIGUSR1);
+}
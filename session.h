@@ -0,0 +1,14 @@
+// Detachable session support
+
+// Start a session daemon listening on Unix socket path and return in a new process whose console is a pty, where the
+// caller should carry on as usual. The daemon relays the pty to one attached client at a time, keeping the last size
+// bytes of output to replay when a client attaches. The calling process attaches to the daemon and exits when
+// detached, it never returns.
+void start_session(char *path, int size);
+
+// Attach the current tty to the session daemon listening on Unix socket path, return 0 when detached or the session
+// ends, or -1 if the session can't be attached.
+int attach_session(char *path);
+
+// Detach the client that is currently attached to this session, if any. Only valid after start_session().
+void detach_session(void);
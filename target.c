@@ -0,0 +1,96 @@
+// Target connection
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#if NETWORK
+#include <sys/socket.h>
+#include <netdb.h>
+#endif
+#include "target.h"
+
+// Open serial device or TCP socket
+int open_target(char *name, bool native, bool dtr, char *error, int size)
+{
+    int fd;
+#if NETWORK
+    if (strchr(name, '/'))
+    {
+#endif
+        // "/dev/ttyXXX"
+        fd = open(name, O_RDWR|O_NOCTTY|O_CLOEXEC);
+        if (!fd) { snprintf(error, size, "Target file opened as fd 0?"); return -1; }
+        if (fd < 0) { snprintf(error, size, "Can't connect to %s: %s", name, strerror(errno)); return 0; }
+
+        // make sure it's raw
+        struct termios io;
+        tcgetattr(fd, &io);
+        io.c_oflag = 0;
+        io.c_lflag = 0;
+        io.c_cc[VMIN] = 1;
+        io.c_cc[VTIME] = 0;
+        if (!native)
+        {
+            // force 115200 N81
+            io.c_cflag = CS8 | CLOCAL | CREAD;
+            io.c_iflag = IGNPAR;
+            cfsetspeed(&io, B115200);
+        }
+        if (tcsetattr(fd, TCSANOW, &io))
+        {
+            snprintf(error, size, "Can't configure %s: %s", name, strerror(errno));
+            close(fd);
+            return -1;
+        }
+
+        if (dtr)
+        {
+            ioctl(fd, TIOCMBIC, (int[]){TIOCM_DTR}); // clear
+            ioctl(fd, TIOCMBIS, (int[]){TIOCM_DTR}); // then set
+            ioctl(fd, TIOCMBIS, (int[]){TIOCM_DTR}); // twice?
+            usleep(50000); // 50 mS
+            tcflush(fd, TCIOFLUSH);
+        }
+#if NETWORK
+    }
+    else if (strchr(name, ':'))
+    {
+        // "host:port"
+        char *host = strdup(name);
+        if (!host) abort();                         // abort on OOM
+        char *port = strchr(host, ':');
+        *port++ = 0;
+        struct addrinfo *ai, hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+        int res = getaddrinfo(host, port, &hints, &ai);
+        free(host);
+        if (res) { snprintf(error, size, "Can't resolve %s: %s", name, gai_strerror(res)); return -1; }
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        int r = 1;
+        if (!fd) snprintf(error, size, "Target socket opened as fd 0?"), r = -1;
+        else if (fd < 0) snprintf(error, size, "Can't create socket: %s", strerror(errno)), r = -1;
+        else if (connect(fd, ai->ai_addr, ai->ai_addrlen))
+        {
+            int e = errno;
+            snprintf(error, size, "Can't connect to %s: %s", name, strerror(e));
+            close(fd);
+            r = (e == ECONNREFUSED || e == ETIMEDOUT || e == ENETUNREACH) ? 0 : -1; // worth retrying?
+        }
+        freeaddrinfo(ai);
+        if (r <= 0) return r;
+    }
+    else
+    {
+        snprintf(error, size, "%s must contain '/' or ':'", name);
+        return -1;
+    }
+#endif
+
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
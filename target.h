@@ -0,0 +1,7 @@
+// Target connection
+
+// Open target name, a serial device if it contains '/' or, with NETWORK, a TCP "host:port" if it contains ':'. Serial
+// devices are made raw and, unless native is true, set to 115200 N-8-1. If dtr is true then DTR is toggled.
+// Return the non-blocking file descriptor, or 0 if the connection failed but may succeed on retry, or -1 if it can't
+// succeed. On failure an explanation is written to error.
+int open_target(char *name, bool native, bool dtr, char *error, int size);
@@ -0,0 +1,41 @@
+// High-character transliteration tables, see charsetrender() in render.c
+
+// Built-in CP437 characters 128-255 as UTF-8, generated with:
+//   python3 -c 'print(bytes(range(128, 256)).decode("cp437"))'
+static const char cp437str[] =
+    "\xC3\x87\xC3\xBC\xC3\xA9\xC3\xA2\xC3\xA4\xC3\xA0\xC3\xA5\xC3\xA7" // 80-87
+    "\xC3\xAA\xC3\xAB\xC3\xA8\xC3\xAF\xC3\xAE\xC3\xAC\xC3\x84\xC3\x85" // 88-8F
+    "\xC3\x89\xC3\xA6\xC3\x86\xC3\xB4\xC3\xB6\xC3\xB2\xC3\xBB\xC3\xB9" // 90-97
+    "\xC3\xBF\xC3\x96\xC3\x9C\xC2\xA2\xC2\xA3\xC2\xA5\xE2\x82\xA7\xC6\x92" // 98-9F
+    "\xC3\xA1\xC3\xAD\xC3\xB3\xC3\xBA\xC3\xB1\xC3\x91\xC2\xAA\xC2\xBA" // A0-A7
+    "\xC2\xBF\xE2\x8C\x90\xC2\xAC\xC2\xBD\xC2\xBC\xC2\xA1\xC2\xAB\xC2\xBB" // A8-AF
+    "\xE2\x96\x91\xE2\x96\x92\xE2\x96\x93\xE2\x94\x82\xE2\x94\xA4\xE2\x95\xA1\xE2\x95\xA2\xE2\x95\x96" // B0-B7
+    "\xE2\x95\x95\xE2\x95\xA3\xE2\x95\x91\xE2\x95\x97\xE2\x95\x9D\xE2\x95\x9C\xE2\x95\x9B\xE2\x94\x90" // B8-BF
+    "\xE2\x94\x94\xE2\x94\xB4\xE2\x94\xAC\xE2\x94\x9C\xE2\x94\x80\xE2\x94\xBC\xE2\x95\x9E\xE2\x95\x9F" // C0-C7
+    "\xE2\x95\x9A\xE2\x95\x94\xE2\x95\xA9\xE2\x95\xA6\xE2\x95\xA0\xE2\x95\x90\xE2\x95\xAC\xE2\x95\xA7" // C8-CF
+    "\xE2\x95\xA8\xE2\x95\xA4\xE2\x95\xA5\xE2\x95\x99\xE2\x95\x98\xE2\x95\x92\xE2\x95\x93\xE2\x95\xAB" // D0-D7
+    "\xE2\x95\xAA\xE2\x94\x98\xE2\x94\x8C\xE2\x96\x88\xE2\x96\x84\xE2\x96\x8C\xE2\x96\x90\xE2\x96\x80" // D8-DF
+    "\xCE\xB1\xC3\x9F\xCE\x93\xCF\x80\xCE\xA3\xCF\x83\xC2\xB5\xCF\x84" // E0-E7
+    "\xCE\xA6\xCE\x98\xCE\xA9\xCE\xB4\xE2\x88\x9E\xCF\x86\xCE\xB5\xE2\x88\xA9" // E8-EF
+    "\xE2\x89\xA1\xC2\xB1\xE2\x89\xA5\xE2\x89\xA4\xE2\x8C\xA0\xE2\x8C\xA1\xC3\xB7\xE2\x89\x88" // F0-F7
+    "\xC2\xB0\xE2\x88\x99\xC2\xB7\xE2\x88\x9A\xE2\x81\xBF\xC2\xB2\xE2\x96\xA0\xC2\xA0"; // F8-FF
+
+static const translit cp437[128] =
+{
+    {  0, 2}, {  2, 2}, {  4, 2}, {  6, 2}, {  8, 2}, { 10, 2}, { 12, 2}, { 14, 2},
+    { 16, 2}, { 18, 2}, { 20, 2}, { 22, 2}, { 24, 2}, { 26, 2}, { 28, 2}, { 30, 2},
+    { 32, 2}, { 34, 2}, { 36, 2}, { 38, 2}, { 40, 2}, { 42, 2}, { 44, 2}, { 46, 2},
+    { 48, 2}, { 50, 2}, { 52, 2}, { 54, 2}, { 56, 2}, { 58, 2}, { 60, 3}, { 63, 2},
+    { 65, 2}, { 67, 2}, { 69, 2}, { 71, 2}, { 73, 2}, { 75, 2}, { 77, 2}, { 79, 2},
+    { 81, 2}, { 83, 3}, { 86, 2}, { 88, 2}, { 90, 2}, { 92, 2}, { 94, 2}, { 96, 2},
+    { 98, 3}, {101, 3}, {104, 3}, {107, 3}, {110, 3}, {113, 3}, {116, 3}, {119, 3},
+    {122, 3}, {125, 3}, {128, 3}, {131, 3}, {134, 3}, {137, 3}, {140, 3}, {143, 3},
+    {146, 3}, {149, 3}, {152, 3}, {155, 3}, {158, 3}, {161, 3}, {164, 3}, {167, 3},
+    {170, 3}, {173, 3}, {176, 3}, {179, 3}, {182, 3}, {185, 3}, {188, 3}, {191, 3},
+    {194, 3}, {197, 3}, {200, 3}, {203, 3}, {206, 3}, {209, 3}, {212, 3}, {215, 3},
+    {218, 3}, {221, 3}, {224, 3}, {227, 3}, {230, 3}, {233, 3}, {236, 3}, {239, 3},
+    {242, 2}, {244, 2}, {246, 2}, {248, 2}, {250, 2}, {252, 2}, {254, 2}, {256, 2},
+    {258, 2}, {260, 2}, {262, 2}, {264, 2}, {266, 3}, {269, 2}, {271, 2}, {273, 3},
+    {276, 3}, {279, 2}, {281, 3}, {284, 3}, {287, 3}, {290, 3}, {293, 2}, {295, 3},
+    {298, 2}, {300, 3}, {303, 2}, {305, 3}, {308, 3}, {311, 2}, {313, 3}, {316, 2}
+};